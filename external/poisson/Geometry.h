@@ -66,6 +66,21 @@ struct Point3D
 	inline Point3D  operator /  ( Real r ) const { return (*this) * ( Real(1.)/r ); }
 };
 
+// Read-only view of an array of points (or normals) stored as consecutive
+// coordinate triples, e.g. a std::vector< Point3D< Real > > or the points
+// of a client's own point set, which are used in place without copying.
+template< class Real >
+struct Point3DView
+{
+	const Real* data;
+	size_t count;
+	Point3DView( void ) : data( NULL ) , count( 0 ) { ; }
+	Point3DView( const Real* d , size_t n ) : data( d ) , count( n ) { ; }
+	Point3DView( const std::vector< Point3D< Real > >& v ) : data( v.empty() ? NULL : v[0].coords ) , count( v.size() ) { ; }
+	inline size_t size( void ) const { return count; }
+	inline Point3D< Real > operator[] ( size_t i ) const { const Real* p = data + 3*i ; return Point3D< Real >( p[0] , p[1] , p[2] ); }
+};
+
 template< class Real >
 struct XForm3x3
 {
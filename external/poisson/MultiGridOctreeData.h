@@ -356,8 +356,8 @@ public:
         // int setTree( char* fileName , int maxDepth , int minDepth , int kernelDepth , Real samplesPerNode ,
         //              Real scaleFactor , int useConfidence , Real constraintWeight , int adaptiveExponent , XForm4x4< Real > xForm=XForm4x4< Real >::Identity );
 
-    int setTree(std::vector< Point3D<float> >& _points,
-                std::vector< Point3D<float> >& _normals,
+    int setTree(const Point3DView<float>& _points,
+                const Point3DView<float>& _normals,
                 int maxDepth ,
                 int minDepth ,
                 int kernelDepth ,
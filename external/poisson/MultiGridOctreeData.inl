@@ -1040,7 +1040,7 @@ bool Octree< Degree , OutputDensity >::_inBounds( Point3D< Real > p ) const
 
 // Non-original implementation; modified by Jascha
 template< int Degree , bool OutputDensity >
-int Octree< Degree , OutputDensity >::setTree( std::vector< Point3D<float> >& _pts, std::vector< Point3D<float> >& _normals, int maxDepth , int minDepth ,
+int Octree< Degree , OutputDensity >::setTree( const Point3DView<float>& _pts, const Point3DView<float>& _normals, int maxDepth , int minDepth ,
                                                int splatDepth , Real samplesPerNode , Real scaleFactor ,
                                                int useConfidence , Real constraintWeight , int adaptiveExponent ,
                                                XForm4x4< Real > xForm )
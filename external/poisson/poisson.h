@@ -6,16 +6,19 @@
 #include "Ply.h"
 #include "MultiGridOctreeData.h"
 
+#include <functional>
+
 #ifdef _OPENMP
 #include "omp.h"
 #endif
 
 
 template< int Degree , class Vertex , bool OutputDensity >
-int Execute(std::vector< Point3D<float> >& pts, std::vector< Point3D<float> >& normals,
-            CoredPoissonVectorMeshData< PlyVertex<float> >& mesh,
+int Execute(const Point3DView<float>& pts, const Point3DView<float>& normals,
+            CoredMeshData< PlyVertex<float> >& mesh,
             int octree_depth = 8, int solver_divide = 8, float point_weight = 4.0f,
-            float samples_per_node = 1.0f, float offset = 1.0f)
+            float samples_per_node = 1.0f, float offset = 1.0f,
+            int threads = 0, const std::function< void( const char* ) >& phase_done = nullptr)
 {
     float isoValue = 0;
     int MaxSolveDepth = octree_depth;
@@ -38,8 +41,9 @@ int Execute(std::vector< Point3D<float> >& pts, std::vector< Point3D<float> >& n
     Octree< Degree , OutputDensity > tree;
 
 #if _OPENMP
-    tree.threads = omp_get_num_procs();
+    tree.threads = threads > 0 ? threads : omp_get_max_threads();
 #else
+    (void)threads;
     tree.threads = 1;
 #endif
 
@@ -71,23 +75,34 @@ int Execute(std::vector< Point3D<float> >& pts, std::vector< Point3D<float> >& n
         tree.ClipTree();
     }
     tree.finalize( IsoDivide );
+    if( phase_done ) phase_done( "octree" );
 
     tree.SetLaplacianConstraints();
+    if( phase_done ) phase_done( "constraints" );
 
     tree.LaplacianMatrixIteration( solver_divide, ShowResidual , MinIters , SolverAccuracy , MaxSolveDepth , FixedIters );
+    if( phase_done ) phase_done( "solve" );
 
     isoValue = tree.GetIsoValue();
     isoValue *= offset; //?? im ursprungscode nicht drin
 
     tree.GetMCIsoTriangles( isoValue , IsoDivide , &mesh , 0 , 1 , !NonManifold , PolygonMesh );
+    if( phase_done ) phase_done( "iso-surface" );
 
     return 1;
 }
 
 
-int Execute2(std::vector< Point3D<float> >& pts, std::vector< Point3D<float> >& normals, CoredPoissonVectorMeshData< PlyVertex<float> >& mesh,
-             int octree = 8, int solver = 8, float point_weight = 4.0f, float samples = 1.0f, float offset = 1.0f)
+// threads <= 0 uses omp_get_max_threads(), i.e., respects OMP_NUM_THREADS.
+// phase_done, if set, is called after building the octree, setting up the
+// constraints, solving, and extracting the iso-surface.
+// pts and normals are read in place. The iso-surface is written to mesh,
+// which can be any CoredMeshData, e.g. CoredPoissonVectorMeshData or a sink
+// that builds the client's mesh type directly.
+int Execute2(const Point3DView<float>& pts, const Point3DView<float>& normals, CoredMeshData< PlyVertex<float> >& mesh,
+             int octree = 8, int solver = 8, float point_weight = 4.0f, float samples = 1.0f, float offset = 1.0f,
+             int threads = 0, const std::function< void( const char* ) >& phase_done = nullptr)
 {
-    return Execute< 2, PlyVertex<Real> , false >(pts, normals, mesh, octree, solver, point_weight, samples, offset);
+    return Execute< 2, PlyVertex<Real> , false >(pts, normals, mesh, octree, solver, point_weight, samples, offset, threads, phase_done);
 }
 
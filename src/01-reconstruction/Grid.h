@@ -76,6 +76,11 @@ public:
         return values_[xyz[2] + xyz[1]*z_res_ + xyz[0]*z_res_*y_res_];
     }
 
+    /// return pointer to the z_res contiguous values of row (x,y,*)
+    const float* row(unsigned int x, unsigned int y) const {
+        return &values_[y*z_res_ + x*z_res_*y_res_];
+    }
+
 
 private:
 
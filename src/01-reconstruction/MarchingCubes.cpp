@@ -10,6 +10,13 @@
 //== INCLUDES =================================================================
 
 #include "MarchingCubes.h"
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 using namespace pmp;
 
 
@@ -19,17 +26,71 @@ class Marching_cubes
 {
 public:
 
-    Marching_cubes(const Grid& _grid, SurfaceMesh& _mesh, Scalar _isoval=0);
+    Marching_cubes(const Grid& _grid, SurfaceMesh& _mesh, Scalar _isoval=0, bool _parallel=true);
+    Marching_cubes(const SparseGrid& _grid, SurfaceMesh& _mesh, Scalar _isoval=0, bool _parallel=true);
+    Marching_cubes(const SliceProvider& _slices,
+                   const vec3& _origin, const vec3& _x_axis, const vec3& _y_axis, const vec3& _z_axis,
+                   unsigned int _x_res, unsigned int _y_res, unsigned int _z_res,
+                   MeshStream& _out, Scalar _isoval=0);
 
-private:
+    /// did the extraction succeed?
+    bool ok() const { return ok_; }
 
-    void process_cube(unsigned int x, unsigned int y, unsigned int z);
-    Vertex add_vertex(const ivec3& p0, const ivec3& p1);
+private:
 
-    const Grid&     grid_;
-    SurfaceMesh&   mesh_;
+    /// vertex on a grid edge, tagged with the slab and x-slice it was created for
+    struct Cached_vertex
+    {
+        int           slab  = -1;
+        int           slice = -1;
+        unsigned int  index = 0;
+    };
+
+    /// Edge vertices are cached per x-slice and indexed by (y,z): y- and
+    /// z-edges of slice x live in yz_edges[x&1], x-edges between slice x
+    /// and x+1 in x_edges. Cubes of a slab are processed with non-decreasing
+    /// x, so two slices suffice; stale entries are detected by their tags.
+    struct Edge_cache
+    {
+        std::vector<Cached_vertex> yz_edges[2];
+        std::vector<Cached_vertex> x_edges;
+    };
+
+    /// Triangles of all cubes with lower corner in the x-slices
+    /// [x_begin, x_end), in local vertex indices. Vertices on the slices
+    /// x_begin and x_end are listed with their cache slot, such that
+    /// neighboring slabs can be stitched. When streaming, points are
+    /// flushed after each layer and offset counts the flushed points.
+    struct Slab
+    {
+        int  id, x_begin, x_end;
+        unsigned int               offset = 0;
+        std::vector<Point>         points;
+        std::vector<unsigned int>  triangles;
+        std::vector<std::pair<size_t, unsigned int> > lower, upper;
+    };
+
+    template <class GridT> void init(const GridT& _grid);
+    void init(const vec3& _origin, const vec3& _x_axis, const vec3& _y_axis, const vec3& _z_axis,
+              unsigned int _x_res, unsigned int _y_res, unsigned int _z_res);
+    void init_cache(Edge_cache& _cache) const;
+    void classify(const float* _values, unsigned char* _signs, size_t _n) const;
+    void process_layer(Slab& _slab, Edge_cache& _cache, unsigned int x,
+                       const float* _slice0, const float* _slice1,
+                       const unsigned char* _signs0, const unsigned char* _signs1,
+                       std::vector<unsigned char>& _types, std::vector<unsigned int>& _active) const;
+    void process_cube(Slab& _slab, Edge_cache& _cache, unsigned int x, unsigned int y, unsigned int z,
+                      unsigned char _cubetype, const float _values[8]) const;
+    unsigned int add_vertex(Slab& _slab, Edge_cache& _cache,
+                            const ivec3& p0, const ivec3& p1, float v0, float v1) const;
+    void merge(std::vector<Slab>& _slabs);
+    vec3 point(const ivec3& p) const { return origin_ + dx_*p[0] + dy_*p[1] + dz_*p[2]; }
+
+    SurfaceMesh*   mesh_;
     Scalar          isoval_;
-    std::map<unsigned long int, Vertex> edge2vertex_;
+    bool            ok_;
+    vec3            origin_, dx_, dy_, dz_;
+    unsigned int    x_res_, y_res_, z_res_;
 
     static int edgeTable[256];
     static int triTable[256][17];
@@ -39,30 +100,377 @@ private:
 //-----------------------------------------------------------------------------
 
 
+template <class GridT>
+void
+Marching_cubes::
+init(const GridT& _grid)
+{
+    init(_grid.origin(), _grid.x_axis(), _grid.y_axis(), _grid.z_axis(),
+         _grid.x_resolution(), _grid.y_resolution(), _grid.z_resolution());
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
 Marching_cubes::
-Marching_cubes(const Grid& _grid, SurfaceMesh& _mesh, Scalar isoval)
-: grid_(_grid), mesh_(_mesh), isoval_(isoval)
+init(const vec3& _origin, const vec3& _x_axis, const vec3& _y_axis, const vec3& _z_axis,
+     unsigned int _x_res, unsigned int _y_res, unsigned int _z_res)
 {
     // clear mesh first
-    _mesh.clear();
-
-    // check whether resolution is small enough for edge2vertex-mapping
-    unsigned long int i = std::numeric_limits<unsigned long int>::max();
-    i /= grid_.x_resolution();
-    i /= grid_.y_resolution();
-    i /= grid_.z_resolution();
-    i >>= 2;
-    if (!i)
+    if (mesh_) mesh_->clear();
+    ok_ = true;
+
+    // store grid geometry, spacing as computed by the grid
+    origin_ = _origin;
+    x_res_  = _x_res;
+    y_res_  = _y_res;
+    z_res_  = _z_res;
+    dx_     = _x_axis / (float)(x_res_-1);
+    dy_     = _y_axis / (float)(y_res_-1);
+    dz_     = _z_axis / (float)(z_res_-1);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Marching_cubes::
+init_cache(Edge_cache& _cache) const
+{
+    // edge caches for two slices, O(y_res*z_res) memory
+    const size_t n = (size_t)y_res_ * z_res_;
+    _cache.yz_edges[0].assign(2*n, Cached_vertex());
+    _cache.yz_edges[1].assign(2*n, Cached_vertex());
+    _cache.x_edges.assign(n, Cached_vertex());
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Marching_cubes::
+classify(const float* _values, unsigned char* _signs, size_t _n) const
+{
+    // branch-free, the compiler vectorizes this loop
+    const float iso = isoval_;
+    for (size_t i=0; i<_n; ++i)
+        _signs[i] = (_values[i] > iso);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Marching_cubes::
+process_layer(Slab& _slab, Edge_cache& _cache, unsigned int x,
+              const float* _slice0, const float* _slice1,
+              const unsigned char* _signs0, const unsigned char* _signs1,
+              std::vector<unsigned char>& _types, std::vector<unsigned int>& _active) const
+{
+    float values[8];
+
+    for (unsigned int y=0; y<y_res_-1; ++y)
     {
-        std::cerr << "Marching_cubes: grid resolution to high!\n";
-        return;
+        // cube types of a whole row, from the sign bits of its four node rows
+        const unsigned char* s0 = _signs0 +  y   *z_res_;
+        const unsigned char* s1 = _signs1 +  y   *z_res_;
+        const unsigned char* s2 = _signs1 + (y+1)*z_res_;
+        const unsigned char* s3 = _signs0 + (y+1)*z_res_;
+        for (unsigned int z=0; z<z_res_-1; ++z)
+            _types[z] = (s0[z]        | s1[z]<<1     | s2[z]<<2     | s3[z]<<3 |
+                         s0[z+1]<<4   | s1[z+1]<<5   | s2[z+1]<<6   | s3[z+1]<<7);
+
+        // collect the active cubes of this row
+        _active.clear();
+        for (unsigned int z=0; z<z_res_-1; ++z)
+            if (_types[z] != 0 && _types[z] != 255)
+                _active.push_back(z);
+
+        // ...and generate their geometry
+        const float* r0 = _slice0 +  y   *z_res_;
+        const float* r1 = _slice1 +  y   *z_res_;
+        const float* r2 = _slice1 + (y+1)*z_res_;
+        const float* r3 = _slice0 + (y+1)*z_res_;
+        for (unsigned int z : _active)
+        {
+            values[0] = r0[z];
+            values[1] = r1[z];
+            values[2] = r2[z];
+            values[3] = r3[z];
+            values[4] = r0[z+1];
+            values[5] = r1[z+1];
+            values[6] = r2[z+1];
+            values[7] = r3[z+1];
+            process_cube(_slab, _cache, x, y, z, _types[z], values);
+        }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Marching_cubes::
+Marching_cubes(const Grid& _grid, SurfaceMesh& _mesh, Scalar isoval, bool _parallel)
+: mesh_(&_mesh), isoval_(isoval)
+{
+    init(_grid);
+
+    // split the x-range of cubes into slabs, a few per thread
+    const int n_layers = x_res_-1;
+    int n_slabs = 1;
+#ifdef _OPENMP
+    if (_parallel)
+        n_slabs = std::min(n_layers, 4*omp_get_max_threads());
+#endif
+    std::vector<Slab> slabs(n_slabs);
+
+    const size_t n_slice = (size_t)y_res_ * z_res_;
+
+#pragma omp parallel if (_parallel)
+    {
+        Edge_cache cache;
+        init_cache(cache);
+        std::vector<unsigned char> signs[2], types(z_res_-1);
+        std::vector<unsigned int>  active;
+        signs[0].resize(n_slice);
+        signs[1].resize(n_slice);
+
+#pragma omp for schedule(dynamic)
+        for (int s=0; s<n_slabs; ++s)
+        {
+            Slab& slab   = slabs[s];
+            slab.id      = s;
+            slab.x_begin = (int)((long)n_layers *  s    / n_slabs);
+            slab.x_end   = (int)((long)n_layers * (s+1) / n_slabs);
+
+            // sign bits of all nodes of the first slice
+            classify(_grid.row(slab.x_begin,0), signs[slab.x_begin&1].data(), n_slice);
+
+            for (unsigned int x=slab.x_begin; x<(unsigned int)slab.x_end; ++x)
+            {
+                // sign bits of the next slice
+                classify(_grid.row(x+1,0), signs[(x+1)&1].data(), n_slice);
+
+                process_layer(slab, cache, x, _grid.row(x,0), _grid.row(x+1,0),
+                              signs[x&1].data(), signs[(x+1)&1].data(), types, active);
+            }
+        }
     }
 
-    // process all cubes
-    for (unsigned int x=0; x<grid_.x_resolution()-1; ++x)
-        for (unsigned int y=0; y<grid_.y_resolution()-1; ++y)
-            for (unsigned int z=0; z<grid_.z_resolution()-1; ++z)
-                process_cube(x,y,z);
+    merge(slabs);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Marching_cubes::
+Marching_cubes(const SparseGrid& _grid, SurfaceMesh& _mesh, Scalar isoval, bool _parallel)
+: mesh_(&_mesh), isoval_(isoval)
+{
+    init(_grid);
+
+    // cubes of a brick also need the first layer of nodes of the next
+    // bricks in x, y and z. Gather them into a local block, nodes of
+    // missing bricks are marked by NaN.
+    const unsigned int B  = SparseGrid::brick_size;
+    const unsigned int N  = B+1;
+    const unsigned int NB = N*N*N;
+
+    // the edge cache needs cubes in x-order: sort bricks into slabs of
+    // equal bx and sweep each slab one x-layer at a time
+    std::vector<unsigned int> bricks(_grid.n_bricks());
+    for (unsigned int b=0; b<bricks.size(); ++b)
+        bricks[b] = b;
+    std::sort(bricks.begin(), bricks.end(), [&](unsigned int a, unsigned int b)
+    {
+        return _grid.brick_coordinates(a)[0] < _grid.brick_coordinates(b)[0];
+    });
+
+    std::vector<size_t> slab_start;
+    for (size_t i=0; i<bricks.size(); ++i)
+        if (i==0 || _grid.brick_coordinates(bricks[i])[0] != _grid.brick_coordinates(bricks[i-1])[0])
+            slab_start.push_back(i);
+    slab_start.push_back(bricks.size());
+
+    const int n_slabs = slab_start.size()-1;
+    std::vector<Slab> slabs(n_slabs);
+
+#pragma omp parallel if (_parallel)
+    {
+        Edge_cache cache;
+        init_cache(cache);
+        std::vector<float> blocks;
+        std::vector<unsigned char> signs(NB), valid(NB), types;
+        float values[8];
+
+#pragma omp for schedule(dynamic)
+        for (int s=0; s<n_slabs; ++s)
+        {
+            const size_t first = slab_start[s], last = slab_start[s+1];
+            const int bx = _grid.brick_coordinates(bricks[first])[0];
+
+            Slab& slab   = slabs[s];
+            slab.id      = s;
+            slab.x_begin = bx*B;
+            slab.x_end   = std::min(bx*B+B, x_res_-1);
+
+            // collect values of the slab's bricks and their upper neighbors
+            blocks.resize((last-first)*NB);
+            types.resize((last-first)*B*B*B);
+            for (size_t i=first; i<last; ++i)
+            {
+                const ivec3& bc = _grid.brick_coordinates(bricks[i]);
+                float* block = &blocks[(i-first)*NB];
+
+                for (unsigned int n=0; n<8; ++n)
+                {
+                    const unsigned int ox = n&1, oy = (n>>1)&1, oz = (n>>2)&1;
+                    const int nb = _grid.brick(bc[0]+ox, bc[1]+oy, bc[2]+oz);
+                    const float* vals = (nb == -1) ? nullptr : _grid.brick_values(nb);
+
+                    for (unsigned int x=ox*B; x<(ox ? N : B); ++x)
+                        for (unsigned int y=oy*B; y<(oy ? N : B); ++y)
+                            for (unsigned int z=oz*B; z<(oz ? N : B); ++z)
+                                block[z + y*N + x*N*N] = vals ? vals[SparseGrid::local_index(x,y,z)]
+                                                              : std::numeric_limits<float>::quiet_NaN();
+                }
+
+                // cube types of the brick, cubes touching nodes outside
+                // the narrow band get type 0 and are skipped
+                classify(block, signs.data(), NB);
+                for (unsigned int n=0; n<NB; ++n)
+                    valid[n] = (block[n] == block[n]);
+
+                unsigned char* t = &types[(i-first)*B*B*B];
+                for (unsigned int x=0; x<B; ++x)
+                    for (unsigned int y=0; y<B; ++y)
+                    {
+                        const unsigned int n0 = y*N + x*N*N, n1 = n0+N*N, n2 = n1+N, n3 = n0+N;
+                        for (unsigned int z=0; z<B; ++z)
+                        {
+                            const unsigned char type =
+                                signs[n0+z]      | signs[n1+z]<<1   | signs[n2+z]<<2   | signs[n3+z]<<3 |
+                                signs[n0+z+1]<<4 | signs[n1+z+1]<<5 | signs[n2+z+1]<<6 | signs[n3+z+1]<<7;
+                            const unsigned char ok =
+                                valid[n0+z]   & valid[n1+z]   & valid[n2+z]   & valid[n3+z] &
+                                valid[n0+z+1] & valid[n1+z+1] & valid[n2+z+1] & valid[n3+z+1];
+                            *t++ = ok ? type : 0;
+                        }
+                    }
+            }
+
+            // process all cubes whose lower corner is in the slab, layer by layer
+            for (unsigned int x=0; x<B; ++x)
+            {
+                const unsigned int gx = bx*B+x;
+                if (gx+1 >= x_res_) break;
+
+                for (size_t i=first; i<last; ++i)
+                {
+                    const ivec3& bc = _grid.brick_coordinates(bricks[i]);
+                    const float* block = &blocks[(i-first)*NB];
+                    const unsigned char* t = &types[((i-first)*B + x)*B*B];
+
+                    for (unsigned int y=0; y<B; ++y)
+                    {
+                        const unsigned int gy = bc[1]*B+y;
+                        if (gy+1 >= y_res_) break;
+
+                        for (unsigned int z=0; z<B; ++z)
+                        {
+                            const unsigned int gz = bc[2]*B+z;
+                            if (gz+1 >= z_res_) break;
+
+                            // skip empty cubes and cubes outside the narrow band
+                            const unsigned char type = t[y*B+z];
+                            if (type == 0 || type == 255)
+                                continue;
+
+                            const float* v = &block[z + y*N + x*N*N];
+                            values[0] = v[0];
+                            values[1] = v[N*N];
+                            values[2] = v[N*N+N];
+                            values[3] = v[N];
+                            values[4] = v[1];
+                            values[5] = v[N*N+1];
+                            values[6] = v[N*N+N+1];
+                            values[7] = v[N+1];
+                            process_cube(slab, cache, gx, gy, gz, type, values);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    merge(slabs);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Marching_cubes::
+Marching_cubes(const SliceProvider& _slices,
+               const vec3& _origin, const vec3& _x_axis, const vec3& _y_axis, const vec3& _z_axis,
+               unsigned int _x_res, unsigned int _y_res, unsigned int _z_res,
+               MeshStream& _out, Scalar isoval)
+: mesh_(nullptr), isoval_(isoval)
+{
+    init(_origin, _x_axis, _y_axis, _z_axis, _x_res, _y_res, _z_res);
+
+    // one slab for the whole volume, but only two slices are resident
+    const size_t n_slice = (size_t)y_res_ * z_res_;
+    std::vector<float>         slices[2];
+    std::vector<unsigned char> signs[2], types(z_res_-1);
+    std::vector<unsigned int>  active;
+    for (int i=0; i<2; ++i)
+    {
+        slices[i].resize(n_slice);
+        signs[i].resize(n_slice);
+    }
+
+    Edge_cache cache;
+    init_cache(cache);
+    Slab slab;
+    slab.id      = 0;
+    slab.x_begin = 0;
+    slab.x_end   = x_res_-1;
+
+    if (!(ok_ = _slices(0, slices[0].data())))
+        return;
+    classify(slices[0].data(), signs[0].data(), n_slice);
+
+    for (unsigned int x=0; x+1<x_res_; ++x)
+    {
+        float*         slice1 = slices[(x+1)&1].data();
+        unsigned char* signs1 = signs[(x+1)&1].data();
+        if (!(ok_ = _slices(x+1, slice1)))
+            return;
+        classify(slice1, signs1, n_slice);
+
+        process_layer(slab, cache, x, slices[x&1].data(), slice1,
+                      signs[x&1].data(), signs1, types, active);
+
+        // stream out this layer, vertex indices continue after the offset
+        for (const Point& p : slab.points)
+            _out.add_vertex(p);
+        for (size_t i=0; i<slab.triangles.size(); i+=3)
+            _out.add_triangle(slab.triangles[i], slab.triangles[i+1], slab.triangles[i+2]);
+
+        slab.offset += slab.points.size();
+        slab.points.clear();
+        slab.triangles.clear();
+        slab.lower.clear();
+        slab.upper.clear();
+    }
 }
 
 
@@ -71,11 +479,11 @@ Marching_cubes(const Grid& _grid, SurfaceMesh& _mesh, Scalar isoval)
 
 void
 Marching_cubes::
-process_cube(unsigned int x, unsigned int y, unsigned int z)
+process_cube(Slab& _slab, Edge_cache& _cache, unsigned int x, unsigned int y, unsigned int z,
+             unsigned char cubetype, const float _values[8]) const
 {
     ivec3               corner[8];
-    Vertex samples[12];
-    unsigned char        cubetype(0);
+    unsigned int        samples[12];
     unsigned int         i;
 
 
@@ -90,71 +498,71 @@ process_cube(unsigned int x, unsigned int y, unsigned int z)
     corner[7] = ivec3(x,   y+1, z+1);
 
 
-    // determine cube type
-    for (i=0; i<8; ++i)
-        if (grid_(corner[i]) > isoval_)
-            cubetype |= (1<<i);
-
-
-    // trivial reject ?
-    if (cubetype == 0 || cubetype == 255)
-        return;
-
-
     // compute samples on cube's edges
-    if (edgeTable[cubetype]&1)    samples[0]  = add_vertex(corner[0], corner[1]);
-    if (edgeTable[cubetype]&2)    samples[1]  = add_vertex(corner[1], corner[2]);
-    if (edgeTable[cubetype]&4)    samples[2]  = add_vertex(corner[3], corner[2]);
-    if (edgeTable[cubetype]&8)    samples[3]  = add_vertex(corner[0], corner[3]);
-    if (edgeTable[cubetype]&16)   samples[4]  = add_vertex(corner[4], corner[5]);
-    if (edgeTable[cubetype]&32)   samples[5]  = add_vertex(corner[5], corner[6]);
-    if (edgeTable[cubetype]&64)   samples[6]  = add_vertex(corner[7], corner[6]);
-    if (edgeTable[cubetype]&128)  samples[7]  = add_vertex(corner[4], corner[7]);
-    if (edgeTable[cubetype]&256)  samples[8]  = add_vertex(corner[0], corner[4]);
-    if (edgeTable[cubetype]&512)  samples[9]  = add_vertex(corner[1], corner[5]);
-    if (edgeTable[cubetype]&1024) samples[10] = add_vertex(corner[2], corner[6]);
-    if (edgeTable[cubetype]&2048) samples[11] = add_vertex(corner[3], corner[7]);
+    Slab& s = _slab; Edge_cache& c = _cache;
+    if (edgeTable[cubetype]&1)    samples[0]  = add_vertex(s, c, corner[0], corner[1], _values[0], _values[1]);
+    if (edgeTable[cubetype]&2)    samples[1]  = add_vertex(s, c, corner[1], corner[2], _values[1], _values[2]);
+    if (edgeTable[cubetype]&4)    samples[2]  = add_vertex(s, c, corner[3], corner[2], _values[3], _values[2]);
+    if (edgeTable[cubetype]&8)    samples[3]  = add_vertex(s, c, corner[0], corner[3], _values[0], _values[3]);
+    if (edgeTable[cubetype]&16)   samples[4]  = add_vertex(s, c, corner[4], corner[5], _values[4], _values[5]);
+    if (edgeTable[cubetype]&32)   samples[5]  = add_vertex(s, c, corner[5], corner[6], _values[5], _values[6]);
+    if (edgeTable[cubetype]&64)   samples[6]  = add_vertex(s, c, corner[7], corner[6], _values[7], _values[6]);
+    if (edgeTable[cubetype]&128)  samples[7]  = add_vertex(s, c, corner[4], corner[7], _values[4], _values[7]);
+    if (edgeTable[cubetype]&256)  samples[8]  = add_vertex(s, c, corner[0], corner[4], _values[0], _values[4]);
+    if (edgeTable[cubetype]&512)  samples[9]  = add_vertex(s, c, corner[1], corner[5], _values[1], _values[5]);
+    if (edgeTable[cubetype]&1024) samples[10] = add_vertex(s, c, corner[2], corner[6], _values[2], _values[6]);
+    if (edgeTable[cubetype]&2048) samples[11] = add_vertex(s, c, corner[3], corner[7], _values[3], _values[7]);
 
     
     // connect samples by triangles
-    for (i=0; triTable[cubetype][i] != -1; i+=3 )
-        mesh_.add_triangle(samples[triTable[cubetype][i  ]],
-                           samples[triTable[cubetype][i+1]],
-                           samples[triTable[cubetype][i+2]]);
+    for (i=0; triTable[cubetype][i] != -1; ++i)
+        _slab.triangles.push_back(samples[triTable[cubetype][i]]);
 }
 
 
 //-----------------------------------------------------------------------------
 
 
-Vertex
+unsigned int
 Marching_cubes::
-add_vertex(const ivec3 &p0, const ivec3 &p1)
+add_vertex(Slab& _slab, Edge_cache& _cache,
+           const ivec3 &p0, const ivec3 &p1, float v0, float v1) const
 {
-    // compute key for edge (p0,p1)
-    unsigned long int i0 = p0[0] + p0[1]*grid_.x_resolution() + p0[2]*grid_.x_resolution()*grid_.y_resolution();
-    unsigned long int i1 = p1[0] + p1[1]*grid_.x_resolution() + p1[2]*grid_.x_resolution()*grid_.y_resolution();
-    unsigned long int idx = std::min(i0, i1);
-    idx <<= 2;
-    if      (p0[0] != p1[0]) idx |= 0;
-    else if (p0[1] != p1[1]) idx |= 1;
-    else if (p0[2] != p1[2]) idx |= 2;
+    // find cache entry of edge (p0,p1) from its lower end point
+    const int x = std::min(p0[0], p1[0]);
+    const int y = std::min(p0[1], p1[1]);
+    const int z = std::min(p0[2], p1[2]);
+    const size_t idx  = (size_t)y*z_res_ + z;
+    const bool   xdir = (p0[0] != p1[0]);
+    const size_t slot = 2*idx + (p0[1] != p1[1] ? 0 : 1);
+    Cached_vertex& entry = xdir ? _cache.x_edges[idx] : _cache.yz_edges[x&1][slot];
 
 
     // find vertex if it has been computed already
-    std::map<unsigned long int, Vertex>::iterator it = edge2vertex_.find(idx);
-    if (it != edge2vertex_.end())
-        return it->second;
+    if (entry.slab == _slab.id && entry.slice == x)
+        return entry.index;
 
 
     // otherwise generate new vertex
-    vec3 pp0(grid_.point(p0));
-    vec3 pp1(grid_.point(p1));
-    float s0 = fabs(grid_(p0)-isoval_);
-    float s1 = fabs(grid_(p1)-isoval_);
+    vec3 pp0(point(p0));
+    vec3 pp1(point(p1));
+    float s0 = fabs(v0-isoval_);
+    float s1 = fabs(v1-isoval_);
     float t  = s0 / (s0+s1);
-    Vertex v = mesh_.add_vertex((1.0f-t)*pp0 + t*pp1);
-    edge2vertex_[idx] = v;
+    unsigned int v = _slab.offset + _slab.points.size();
+    _slab.points.push_back((1.0f-t)*pp0 + t*pp1);
+    entry.slab  = _slab.id;
+    entry.slice = x;
+    entry.index = v;
+
+
+    // remember vertices shared with the neighboring slabs
+    if (!xdir)
+    {
+        if (x == _slab.x_begin) _slab.lower.push_back(std::make_pair(slot, v));
+        if (x == _slab.x_end)   _slab.upper.push_back(std::make_pair(slot, v));
+    }
+
     return v;
 }
 
@@ -162,6 +570,62 @@ add_vertex(const ivec3 &p0, const ivec3 &p1)
 //-----------------------------------------------------------------------------
 
 
+void
+Marching_cubes::
+merge(std::vector<Slab>& _slabs)
+{
+    size_t n_vertices(0), n_faces(0);
+    for (const Slab& slab : _slabs)
+    {
+        n_vertices += slab.points.size();
+        n_faces    += slab.triangles.size() / 3;
+    }
+    mesh_->reserve(n_vertices, 3*n_faces/2, n_faces);
+
+
+    // Add slabs in x-order. Vertices on the lower slice of a slab were
+    // already added by its predecessor, which yields exactly the vertex
+    // and face order of a single serial sweep.
+    std::vector<Vertex> vertices, prev_vertices;
+    const Slab* prev = nullptr;
+    for (Slab& slab : _slabs)
+    {
+        vertices.assign(slab.points.size(), Vertex());
+
+        if (prev && prev->x_end == slab.x_begin)
+        {
+            std::sort(slab.lower.begin(), slab.lower.end());
+            auto it = prev->upper.begin();
+            for (const auto& l : slab.lower)
+            {
+                while (it != prev->upper.end() && it->first < l.first) ++it;
+                if (it != prev->upper.end() && it->first == l.first)
+                    vertices[l.second] = prev_vertices[it->second];
+            }
+        }
+
+        for (size_t i=0; i<slab.points.size(); ++i)
+            if (!vertices[i].is_valid())
+                vertices[i] = mesh_->add_vertex(slab.points[i]);
+
+        for (size_t i=0; i<slab.triangles.size(); i+=3)
+            mesh_->add_triangle(vertices[slab.triangles[i  ]],
+                               vertices[slab.triangles[i+1]],
+                               vertices[slab.triangles[i+2]]);
+
+        // free slab memory, keep the upper slice for the next slab
+        std::sort(slab.upper.begin(), slab.upper.end());
+        std::vector<Point>().swap(slab.points);
+        std::vector<unsigned int>().swap(slab.triangles);
+        std::swap(vertices, prev_vertices);
+        prev = &slab;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
 int Marching_cubes::edgeTable[256]=
 {
     0x0  , 0x109, 0x203, 0x30a, 0x406, 0x50f, 0x605, 0x70c,
@@ -466,9 +930,62 @@ int Marching_cubes::triTable[256][17] =
 //-----------------------------------------------------------------------------
 
 
-void marching_cubes(const Grid& _grid, SurfaceMesh& _mesh, Scalar isoval)
+void marching_cubes(const Grid& _grid, SurfaceMesh& _mesh, Scalar isoval, bool parallel)
+{
+    Marching_cubes mc(_grid, _mesh, isoval, parallel);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void marching_cubes(const SparseGrid& _grid, SurfaceMesh& _mesh, Scalar isoval, bool parallel)
+{
+    Marching_cubes mc(_grid, _mesh, isoval, parallel);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+SliceProvider raw_volume_slices(const std::string& _filename,
+                                unsigned int _y_res, unsigned int _z_res,
+                                size_t _offset)
+{
+    std::shared_ptr<FILE> file(fopen(_filename.c_str(), "rb"),
+                               [](FILE* f) { if (f) fclose(f); });
+    if (!file)
+        std::cerr << "raw_volume_slices: cannot open " << _filename << std::endl;
+
+    const size_t n = (size_t)_y_res * _z_res;
+
+    return [file, n, _offset](unsigned int _x, float* _values)
+    {
+        if (!file)
+            return false;
+        const long long pos = (long long)_offset + (long long)_x * n * sizeof(float);
+#ifdef _WIN32
+        if (_fseeki64(file.get(), pos, SEEK_SET) != 0) return false;
+#else
+        if (fseeko(file.get(), (off_t)pos, SEEK_SET) != 0) return false;
+#endif
+        return fread(_values, sizeof(float), n, file.get()) == n;
+    };
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool marching_cubes(const SliceProvider& _slices,
+                    const vec3& _origin,
+                    const vec3& _x_axis, const vec3& _y_axis, const vec3& _z_axis,
+                    unsigned int _x_res, unsigned int _y_res, unsigned int _z_res,
+                    MeshStream& _out, Scalar isoval)
 {
-    Marching_cubes mc(_grid, _mesh, isoval);
+    Marching_cubes mc(_slices, _origin, _x_axis, _y_axis, _z_axis,
+                      _x_res, _y_res, _z_res, _out, isoval);
+    return mc.ok();
 }
 
 
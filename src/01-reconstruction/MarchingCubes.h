@@ -10,8 +10,11 @@
 #pragma once
 
 #include "Grid.h"
+#include "SparseGrid.h"
+#include "MeshStream.h"
 #include <pmp/SurfaceMesh.h>
-#include <map>
+#include <functional>
+#include <string>
 
 using namespace pmp;
 
@@ -19,9 +22,40 @@ using namespace pmp;
 
 /** use the Marching Cubes algorithm to extract the iso-surface to a certain
     iso-value (\c _isoval) from a grid of scalar values (\c _grid) and store
-    the resulting triangle mesh in \c _mesh. 
+    the resulting triangle mesh in \c _mesh. If \c _parallel is set, slabs
+    of the grid are processed by all threads and stitched afterwards; the
+    resulting mesh is identical to the serial one.
 */
-void marching_cubes(const Grid& _grid, SurfaceMesh& _mesh, Scalar _isoval=0);
+void marching_cubes(const Grid& _grid, SurfaceMesh& _mesh, Scalar _isoval=0,
+                    bool _parallel=true);
+
+/** marching cubes on a sparse grid: only cubes whose eight corners lie in
+    allocated bricks are processed. */
+void marching_cubes(const SparseGrid& _grid, SurfaceMesh& _mesh, Scalar _isoval=0,
+                    bool _parallel=true);
+
+
+/** Callback that fills \c _values with the y_res*z_res values of x-slice
+    \c _x, in the layout of a Grid (index z + y*z_res). Returns false if the
+    slice cannot be provided. */
+typedef std::function<bool(unsigned int _x, float* _values)> SliceProvider;
+
+/** Returns a SliceProvider reading slices from a raw volume file of 32-bit
+    floats stored in Grid layout (x slowest, z fastest), optionally after a
+    header of \c _offset bytes. Slices are read on demand. */
+SliceProvider raw_volume_slices(const std::string& _filename,
+                                unsigned int _y_res, unsigned int _z_res,
+                                size_t _offset=0);
+
+/** out-of-core marching cubes: the grid (described as in the Grid
+    constructor) is pulled slice by slice from \c _slices, only two slices
+    are kept in memory, and the triangles are streamed to \c _out while the
+    volume is swept. Returns false if a slice could not be provided. */
+bool marching_cubes(const SliceProvider& _slices,
+                    const vec3& _origin,
+                    const vec3& _x_axis, const vec3& _y_axis, const vec3& _z_axis,
+                    unsigned int _x_res, unsigned int _y_res, unsigned int _z_res,
+                    MeshStream& _out, Scalar _isoval=0);
 
 
 //=============================================================================
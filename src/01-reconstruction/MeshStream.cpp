@@ -0,0 +1,140 @@
+//=============================================================================
+//
+//   Exercise code for the lecture "Geometric Modeling"
+//   by Prof. Dr. Mario Botsch, TU Dortmund
+//
+//   Copyright (C) 2023 Computer Graphics Group, TU Dortmund.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "MeshStream.h"
+#include <cstring>
+#include <vector>
+
+
+//== IMPLEMENTATION ==========================================================
+
+
+PlyMeshStream::
+PlyMeshStream(const std::string& _filename)
+: file_(fopen(_filename.c_str(), "wb")), faces_(tmpfile()),
+  n_vertices_(0), n_faces_(0), ok_(true)
+{
+    // placeholder header, rewritten with the final counts in close()
+    if (file_)
+        write_header();
+    ok_ = is_open();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+PlyMeshStream::
+~PlyMeshStream()
+{
+    close();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+PlyMeshStream::
+write_header()
+{
+    // fixed-width counts, such that the header keeps its size
+    fprintf(file_,
+            "ply\n"
+            "format binary_little_endian 1.0\n"
+            "element vertex %010u\n"
+            "property float x\n"
+            "property float y\n"
+            "property float z\n"
+            "element face %010u\n"
+            "property list uchar int vertex_indices\n"
+            "end_header\n",
+            n_vertices_, n_faces_);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+PlyMeshStream::
+add_vertex(const Point& _p)
+{
+    if (!is_open()) return;
+
+    const float xyz[3] = { (float)_p[0], (float)_p[1], (float)_p[2] };
+    ok_ &= (fwrite(xyz, sizeof(float), 3, file_) == 3);
+    ++n_vertices_;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+PlyMeshStream::
+add_triangle(unsigned int _v0, unsigned int _v1, unsigned int _v2)
+{
+    if (!is_open()) return;
+
+    const unsigned int idx[3] = { _v0, _v1, _v2 };
+    ok_ &= (fwrite(idx, sizeof(unsigned int), 3, faces_) == 3);
+    ++n_faces_;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+PlyMeshStream::
+close()
+{
+    if (!file_)
+    {
+        if (faces_) fclose(faces_);
+        faces_ = nullptr;
+        return ok_;
+    }
+
+    if (faces_)
+    {
+        // append triangles as (count, indices) records
+        std::vector<unsigned int> idx(3*4096);
+        std::vector<char>         buffer(13*4096);
+        const unsigned char       three = 3;
+        rewind(faces_);
+        size_t n;
+        while ((n = fread(idx.data(), 3*sizeof(unsigned int), 4096, faces_)) > 0)
+        {
+            char* b = buffer.data();
+            for (size_t i=0; i<n; ++i, b+=13)
+            {
+                b[0] = three;
+                memcpy(b+1, &idx[3*i], 3*sizeof(unsigned int));
+            }
+            ok_ &= (fwrite(buffer.data(), 13, n, file_) == n);
+        }
+        fclose(faces_);
+        faces_ = nullptr;
+    }
+
+    // fill in the element counts
+    rewind(file_);
+    write_header();
+
+    ok_ &= (fclose(file_) == 0);
+    file_ = nullptr;
+    return ok_;
+}
+
+
+//=============================================================================
@@ -0,0 +1,78 @@
+//=============================================================================
+//
+//   Exercise code for the lecture "Geometric Modeling"
+//   by Prof. Dr. Mario Botsch, TU Dortmund
+//
+//   Copyright (C) 2023 Computer Graphics Group, TU Dortmund.
+//
+//=============================================================================
+
+#pragma once
+
+#include <pmp/Types.h>
+#include <cstdio>
+#include <string>
+
+using namespace pmp;
+
+//=============================================================================
+
+/** Receiver for meshes that are generated incrementally and are too large
+    to be kept in memory. Vertices are implicitly numbered 0, 1, 2, ... in
+    the order they are added; triangles refer to these numbers. */
+class MeshStream
+{
+public:
+
+    virtual ~MeshStream() {}
+
+    /// append vertex at position \c _p
+    virtual void add_vertex(const Point& _p) = 0;
+
+    /// append triangle (\c _v0, \c _v1, \c _v2) of previously added vertices
+    virtual void add_triangle(unsigned int _v0, unsigned int _v1, unsigned int _v2) = 0;
+};
+
+
+//=============================================================================
+
+/** Writes a streamed mesh to a binary (little endian) PLY file. Vertices go
+    directly to the file, triangles are buffered in a temporary file and
+    appended by close(), which also fills in the element counts. */
+class PlyMeshStream : public MeshStream
+{
+public:
+
+    /// open \c _filename for writing, check success with is_open()
+    PlyMeshStream(const std::string& _filename);
+
+    /// calls close()
+    ~PlyMeshStream();
+
+    /// are both the output and the temporary file open?
+    bool is_open() const { return file_ && faces_; }
+
+    /// finish the file, return whether all data was written
+    bool close();
+
+    void add_vertex(const Point& _p) override;
+    void add_triangle(unsigned int _v0, unsigned int _v1, unsigned int _v2) override;
+
+    /// number of vertices written so far
+    unsigned int n_vertices() const { return n_vertices_; }
+
+    /// number of triangles written so far
+    unsigned int n_faces() const { return n_faces_; }
+
+private:
+
+    void write_header();
+
+    FILE*         file_;
+    FILE*         faces_;
+    unsigned int  n_vertices_, n_faces_;
+    bool          ok_;
+};
+
+
+//=============================================================================
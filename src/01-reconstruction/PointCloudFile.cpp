@@ -0,0 +1,1053 @@
+//=============================================================================
+//
+//   Exercise code for the lecture "Geometric Modeling"
+//   by Prof. Dr. Mario Botsch, TU Dortmund
+//
+//   Copyright (C) 2023 Computer Graphics Group, TU Dortmund.
+//
+//=============================================================================
+
+// our includes
+#include "PointCloudFile.h"
+
+// system includes
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <unordered_map>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace pmp;
+
+//=============================================================================
+
+
+static_assert(sizeof(MappedPointCloud::Header) == 64, "unexpected header size");
+static_assert(sizeof(MappedPointCloud::Chunk)  == 24, "unexpected chunk size");
+
+constexpr char MappedPointCloud::magic[8];
+
+
+// helper function from PMP
+template <typename T>
+void tfread(FILE* in, const T& t)
+{
+    size_t n_items = fread((char*)&t, 1, sizeof(t), in);
+    assert(n_items > 0);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+static std::string extension(const char* _filename)
+{
+    std::string filename(_filename);
+    std::string::size_type dot(filename.rfind("."));
+    if (dot == std::string::npos) return "";
+    std::string ext = filename.substr(dot+1, filename.length()-dot-1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), tolower);
+    return ext;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Columns of a text point cloud format, one point per line.
+struct Text_format
+{
+    int   n_columns;    ///< minimum number of values per line
+    int   point;        ///< first column of point coordinates
+    int   normal;       ///< first column of normal
+    int   color;        ///< first column of color, -1 if none
+    float color_scale;  ///< factor applied to colors
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+static inline bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Locale-independent parser for decimal floats like -1.25e-3. Returns the
+/// position after the number, or nullptr if there is none at \c s.
+static const char* parse_float(const char* s, const char* end, float& f)
+{
+    static const double pow10[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                    1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+'))
+        negative = (*s++ == '-');
+
+    // up to 19 significant digits fit into the mantissa
+    uint64_t mantissa  = 0;
+    int      exponent  = 0;
+    int      n_digits  = 0;
+    bool     has_digit = false;
+
+    for (; s < end && *s >= '0' && *s <= '9'; ++s, has_digit = true)
+    {
+        if (n_digits < 19)
+        {
+            mantissa = 10*mantissa + (*s - '0');
+            if (mantissa) ++n_digits;
+        }
+        else ++exponent;
+    }
+
+    if (s < end && *s == '.')
+    {
+        for (++s; s < end && *s >= '0' && *s <= '9'; ++s, has_digit = true)
+        {
+            if (n_digits < 19)
+            {
+                mantissa = 10*mantissa + (*s - '0');
+                if (mantissa) ++n_digits;
+                --exponent;
+            }
+        }
+    }
+
+    if (!has_digit)
+        return nullptr;
+
+    if (s < end && (*s == 'e' || *s == 'E'))
+    {
+        const char* e = s+1;
+        bool negative_exponent = false;
+        if (e < end && (*e == '-' || *e == '+'))
+            negative_exponent = (*e++ == '-');
+
+        if (e < end && *e >= '0' && *e <= '9')
+        {
+            int x = 0;
+            for (; e < end && *e >= '0' && *e <= '9'; ++e)
+                if (x < 10000) x = 10*x + (*e - '0');
+            exponent += negative_exponent ? -x : x;
+            s = e;
+        }
+    }
+
+    double v = (double)mantissa;
+    if      (exponent == 0)                     {}
+    else if (exponent > 0 && exponent <= 22)    v *= pow10[exponent];
+    else if (exponent < 0 && exponent >= -22)   v /= pow10[-exponent];
+    else                                        v *= std::pow(10.0, exponent);
+
+    f = (float)(negative ? -v : v);
+    return s;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Split \c _text into chunks of about 4MB that start after a newline.
+/// Returns the n_chunks+1 chunk boundaries.
+static std::vector<size_t> split_lines(const char* _text, size_t _size)
+{
+    const size_t chunk_size = size_t(1) << 22;
+    const size_t n_chunks   = std::max(size_t(1), (_size + chunk_size-1) / chunk_size);
+
+    std::vector<size_t> begin(n_chunks+1);
+    begin[0] = 0;
+    begin[n_chunks] = _size;
+    for (size_t c=1; c<n_chunks; ++c)
+    {
+        const char* p = (const char*)memchr(_text + c*chunk_size, '\n', _size - c*chunk_size);
+        begin[c] = p ? (p - _text) + 1 : _size;
+    }
+    return begin;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Parse the lines in [_begin, _end) and call _sink(point, normal, color)
+/// for every line with at least format.n_columns values.
+template <class Sink>
+static void parse_lines(const char* _begin, const char* _end, const Text_format& _format, Sink&& _sink)
+{
+    const pmp::Color black(0,0,0);
+    const char* p = _begin;
+    float values[16];
+
+    while (p < _end)
+    {
+        const char* nl  = (const char*)memchr(p, '\n', _end-p);
+        const char* eol = nl ? nl : _end;
+
+        // parse the values of this line
+        int n = 0;
+        while (n < _format.n_columns)
+        {
+            while (p < eol && is_blank(*p)) ++p;
+            const char* q = parse_float(p, eol, values[n]);
+            if (!q) break;
+            p = q;
+            ++n;
+        }
+
+        if (n == _format.n_columns)
+        {
+            const float* v = values + _format.point;
+            const float* w = values + _format.normal;
+            const float* c = values + _format.color;
+            _sink(pmp::Point(v[0], v[1], v[2]),
+                  pmp::Normal(w[0], w[1], w[2]),
+                  _format.color >= 0 ? _format.color_scale * pmp::Color(c[0], c[1], c[2]) : black);
+        }
+
+        p = nl ? nl+1 : _end;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Read a text point cloud: the mapped file is split into chunks at line
+/// boundaries, which are parsed in parallel into pre-sized arrays. Lines
+/// with fewer than format.n_columns values are skipped.
+static bool read_text(const char* filename, const Text_format& format, PointCloudData& data)
+{
+    MappedFile file;
+    if (!file.open(filename)) return false;
+
+    const char* text = file.data();
+    const std::vector<size_t> begin = split_lines(text, file.size());
+    const int n_chunks = begin.size()-1;
+
+
+    // counting pass: number of lines per chunk, an upper bound for the
+    // number of points
+    std::vector<size_t> offset(n_chunks+1, 0), count(n_chunks, 0);
+#pragma omp parallel for schedule(dynamic)
+    for (int c=0; c<n_chunks; ++c)
+    {
+        const char* p   = text + begin[c];
+        const char* end = text + begin[c+1];
+        size_t n = 0;
+        while (p < end)
+        {
+            const char* nl = (const char*)memchr(p, '\n', end-p);
+            ++n;
+            p = nl ? nl+1 : end;
+        }
+        offset[c+1] = n;
+    }
+    for (int c=0; c<n_chunks; ++c)
+        offset[c+1] += offset[c];
+
+    data.points.resize(offset[n_chunks]);
+    data.normals.resize(offset[n_chunks]);
+    data.colors.resize(offset[n_chunks], pmp::Color(0,0,0));
+
+
+    // parsing pass: every chunk writes to its own range
+#pragma omp parallel for schedule(dynamic)
+    for (int c=0; c<n_chunks; ++c)
+    {
+        size_t idx = offset[c];
+        parse_lines(text + begin[c], text + begin[c+1], format,
+                    [&](const pmp::Point& p, const pmp::Normal& n, const pmp::Color& col)
+                    {
+                        data.points[idx]  = p;
+                        data.normals[idx] = n;
+                        data.colors[idx]  = col;
+                        ++idx;
+                    });
+        count[c] = idx - offset[c];
+    }
+
+
+    // close the gaps left by skipped lines
+    size_t n = 0;
+    for (int c=0; c<n_chunks; ++c)
+    {
+        if (n != offset[c])
+        {
+            std::copy_n(data.points.begin()  + offset[c], count[c], data.points.begin()  + n);
+            std::copy_n(data.normals.begin() + offset[c], count[c], data.normals.begin() + n);
+            std::copy_n(data.colors.begin()  + offset[c], count[c], data.colors.begin()  + n);
+        }
+        n += count[c];
+    }
+    data.points.resize(n);
+    data.normals.resize(n);
+    data.colors.resize(n);
+
+    data.has_colors = (format.color >= 0);
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Column layout of the text formats, false for other formats.
+static bool text_format(const std::string& ext, Text_format& format)
+{
+    if (ext == "xyz")   { format = { 6, 0, 3, -1, 1.0f };        return true; } // x y z nx ny nz
+    if (ext == "cnoff") { format = { 9, 0, 3, 6, 1.0f/255.0f }; return true; } // x y z nx ny nz r g b
+    if (ext == "txt")   { format = { 9, 0, 6, 3, 1.0f/255.0f }; return true; } // x y z r g b nx ny nz
+    return false;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Read a point set with normals and colors from a .cxyz file.
+static bool read_cxyz(const char* filename, PointCloudData& data)
+{
+    std::ifstream ifs(filename);
+    if (!ifs) return false;
+
+    float x, y, z;
+    float nx, ny, nz;
+    float cx, cy, cz;
+
+    std::string dummy;
+    std::getline(ifs, dummy);
+    std::getline(ifs, dummy);
+    while (ifs && !ifs.eof())
+    {
+        ifs >> x >> y >> z;
+        ifs >> nx >> ny >> nz;
+        ifs >> cx >> cy >> cz;
+        data.points.push_back(pmp::Point(x,y,z));
+        data.normals.push_back(pmp::Normal(nx,ny,nz));
+        data.colors.push_back(pmp::Color(cx,cy,cz));
+    }
+
+    ifs.close();
+    data.has_colors = true;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Read a point set with normals and colors from a binary .pts file.
+static bool read_pts(const char* filename, PointCloudData& data)
+{
+    FILE* in = fopen(filename, "rb");
+    if (!in) return false;
+
+    unsigned int n;
+    tfread(in, n);
+    tfread(in, data.has_colors);
+
+    std::cout << n << " points " << (data.has_colors ? "with" : "without") << " colors\n";
+
+    data.points.resize(n);
+    fread((char*)data.points.data(), sizeof(pmp::Point), n, in);
+
+    data.normals.resize(n);
+    fread((char*)data.normals.data(), sizeof(pmp::Normal), n, in);
+
+    data.colors.resize(n, pmp::Color(0,0,0));
+    if (data.has_colors)
+        fread((char*)data.colors.data(), sizeof(pmp::Color), n, in);
+
+    fclose(in);
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Read a point set from a memory-mapped binary .bpc file.
+static bool read_bpc(const char* filename, PointCloudData& data)
+{
+    MappedPointCloud pc;
+    if (!pc.open(filename)) return false;
+
+    const size_t n = pc.size();
+    data.points.assign(pc.points(), pc.points()+n);
+
+    if (pc.normals())
+        data.normals.assign(pc.normals(), pc.normals()+n);
+    else
+        data.normals.assign(n, pmp::Normal(0,0,0));
+
+    data.has_colors = (pc.colors() != nullptr);
+    if (data.has_colors)
+        data.colors.assign(pc.colors(), pc.colors()+n);
+    else
+        data.colors.assign(n, pmp::Color(0,0,0));
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+//== VOXEL GRID DOWNSAMPLING ==================================================
+
+
+/// sums of the points, normals and colors in one voxel
+struct Voxel_sum
+{
+    Point         point  = Point(0,0,0);
+    Normal        normal = Normal(0,0,0);
+    Color         color  = Color(0,0,0);
+    unsigned int  count  = 0;
+};
+
+/// integer voxel coordinates
+struct Voxel_key
+{
+    int x, y, z;
+    bool operator==(const Voxel_key& k) const { return x==k.x && y==k.y && z==k.z; }
+    bool operator<(const Voxel_key& k) const
+    {
+        return x<k.x || (x==k.x && (y<k.y || (y==k.y && z<k.z)));
+    }
+};
+
+struct Voxel_hash
+{
+    size_t operator()(const Voxel_key& k) const
+    {
+        return (size_t)k.x*73856093u ^ (size_t)k.y*19349663u ^ (size_t)k.z*83492791u;
+    }
+};
+
+typedef std::unordered_map<Voxel_key, Voxel_sum, Voxel_hash> Voxel_map;
+
+
+//-----------------------------------------------------------------------------
+
+
+/// The voxel grid collecting a downsampled point cloud. Chunks of the input
+/// are binned into local maps, which are merged into the grid in order.
+class Voxel_grid
+{
+public:
+
+    Voxel_grid(const VoxelDownsampling& _ds)
+    : size_(_ds.voxel_size), max_voxels_(std::numeric_limits<size_t>::max())
+    {
+        // rough size of a hash map entry, including node and bucket
+        const size_t bytes_per_voxel = sizeof(std::pair<Voxel_key, Voxel_sum>) + 3*sizeof(void*);
+        if (_ds.memory_budget)
+            max_voxels_ = std::max(size_t(1), _ds.memory_budget / bytes_per_voxel);
+    }
+
+    /// current voxel size
+    float size() const { return size_; }
+
+    /// voxel containing point \c _p for voxel size \c _size
+    static Voxel_key key(const Point& _p, float _size)
+    {
+        const double limit = 1 << 30;
+        const auto c = [&](int i) { return (int)std::max(-limit, std::min(limit, std::floor((double)_p[i] / _size))); };
+        return Voxel_key{ c(0), c(1), c(2) };
+    }
+
+    /// add a single point to a map
+    static void add(Voxel_map& _map, float _size, const Point& _p, const Normal& _n, const Color& _c)
+    {
+        Voxel_sum& v = _map[key(_p, _size)];
+        v.point  += _p;
+        v.normal += _n;
+        v.color  += _c;
+        v.count  += 1;
+    }
+
+    /// add a local map, coarsen the grid if it exceeds the budget
+    void merge(const Voxel_map& _local)
+    {
+        for (const auto& v : _local)
+            add(map_, size_, v.second);
+        while (map_.size() > max_voxels_)
+            coarsen();
+    }
+
+    /// number of voxels
+    size_t n_voxels() const { return map_.size(); }
+
+    /// one point per voxel, ordered by voxel
+    void extract(PointCloudData& _data, bool _has_colors) const
+    {
+        std::vector<std::pair<Voxel_key, const Voxel_sum*> > voxels;
+        voxels.reserve(map_.size());
+        for (const auto& v : map_)
+            voxels.push_back(std::make_pair(v.first, &v.second));
+        std::sort(voxels.begin(), voxels.end(),
+                  [](const std::pair<Voxel_key, const Voxel_sum*>& a,
+                     const std::pair<Voxel_key, const Voxel_sum*>& b) { return a.first < b.first; });
+
+        _data.points.resize(voxels.size());
+        _data.normals.resize(voxels.size());
+        _data.colors.resize(voxels.size());
+        for (size_t i=0; i<voxels.size(); ++i)
+        {
+            const Voxel_sum& v = *voxels[i].second;
+            const Scalar     n = norm(v.normal);
+            _data.points[i]  = v.point / (Scalar)v.count;
+            _data.normals[i] = (n > 0) ? v.normal / n : v.normal;
+            _data.colors[i]  = v.color / (Scalar)v.count;
+        }
+        _data.has_colors = _has_colors;
+
+        std::cout << "Downsampled to " << voxels.size() << " points (voxel size " << size_ << ")\n";
+    }
+
+private:
+
+    /// add a voxel sum, binned by its centroid
+    static void add(Voxel_map& _map, float _size, const Voxel_sum& _s)
+    {
+        Voxel_sum& v = _map[key(_s.point / (Scalar)_s.count, _size)];
+        v.point  += _s.point;
+        v.normal += _s.normal;
+        v.color  += _s.color;
+        v.count  += _s.count;
+    }
+
+    /// double the voxel size and re-bin all voxels
+    void coarsen()
+    {
+        size_ *= 2.0f;
+        Voxel_map old;
+        std::swap(old, map_);
+        for (const auto& v : old)
+            add(map_, size_, v.second);
+        std::cout << "Voxel grid exceeds memory budget, voxel size increased to " << size_ << std::endl;
+    }
+
+    float      size_;
+    size_t     max_voxels_;
+    Voxel_map  map_;
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Downsample \c _n_chunks chunks of input into \c _grid. Batches of
+/// chunks are binned in parallel by _bin(chunk, local_map, voxel_size) and
+/// merged in chunk order, which keeps the result deterministic and the
+/// memory bounded by the grid plus one local map per thread.
+template <class Bin>
+static void downsample_chunks(int _n_chunks, Voxel_grid& _grid, Bin&& _bin)
+{
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = omp_get_max_threads();
+#endif
+
+    std::vector<Voxel_map> local(n_threads);
+    for (int first=0; first<_n_chunks; first+=n_threads)
+    {
+        const int   last = std::min(_n_chunks, first+n_threads);
+        const float size = _grid.size();
+
+#pragma omp parallel for schedule(dynamic)
+        for (int c=first; c<last; ++c)
+        {
+            local[c-first].clear();
+            _bin(c, local[c-first], size);
+        }
+
+        for (int c=first; c<last; ++c)
+            _grid.merge(local[c-first]);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Stream a text point cloud through the voxel grid.
+static bool read_text_downsampled(const char* filename, const Text_format& format,
+                                  const VoxelDownsampling& ds, PointCloudData& data)
+{
+    MappedFile file;
+    if (!file.open(filename)) return false;
+
+    const char* text = file.data();
+    const std::vector<size_t> begin = split_lines(text, file.size());
+
+    Voxel_grid grid(ds);
+    downsample_chunks(begin.size()-1, grid, [&](int c, Voxel_map& map, float size)
+    {
+        parse_lines(text + begin[c], text + begin[c+1], format,
+                    [&](const Point& p, const Normal& n, const Color& col)
+                    {
+                        Voxel_grid::add(map, size, p, n, col);
+                    });
+    });
+
+    grid.extract(data, format.color >= 0);
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Stream a memory-mapped .bpc file, or points already in memory, through
+/// the voxel grid.
+static void downsample(const Point* points, const Normal* normals, const Color* colors,
+                       size_t n, const VoxelDownsampling& ds, PointCloudData& data)
+{
+    const size_t chunk_size = size_t(1) << 18;
+    const int    n_chunks   = (n + chunk_size-1) / chunk_size;
+
+    Voxel_grid grid(ds);
+    downsample_chunks(n_chunks, grid, [&](int c, Voxel_map& map, float size)
+    {
+        const Normal zero(0,0,0);
+        const size_t end = std::min(n, (c+1)*chunk_size);
+        for (size_t i=c*chunk_size; i<end; ++i)
+            Voxel_grid::add(map, size, points[i],
+                            normals ? normals[i] : zero,
+                            colors  ? colors[i]  : zero);
+    });
+
+    grid.extract(data, colors != nullptr);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool is_point_cloud_file(const char* _filename)
+{
+    const std::string ext = extension(_filename);
+    return (ext == "xyz" || ext == "cnoff" || ext == "cxyz" ||
+            ext == "txt" || ext == "pts"   || ext == "bpc");
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool read_point_cloud(const char* _filename, PointCloudData& _data,
+                      const VoxelDownsampling& _downsampling)
+{
+    _data = PointCloudData();
+
+    const std::string ext = extension(_filename);
+    const bool reduce = (_downsampling.voxel_size > 0);
+    Text_format format;
+
+    // text and .bpc files are downsampled while they are read
+    if (reduce && text_format(ext, format))
+        return read_text_downsampled(_filename, format, _downsampling, _data);
+
+    if (reduce && ext == "bpc")
+    {
+        MappedPointCloud pc;
+        if (!pc.open(_filename)) return false;
+        downsample(pc.points(), pc.normals(), pc.colors(), pc.size(), _downsampling, _data);
+        return true;
+    }
+
+    bool ok = false;
+    if      (text_format(ext, format)) ok = read_text(_filename, format, _data);
+    else if (ext == "cxyz")            ok = read_cxyz(_filename, _data);
+    else if (ext == "pts")             ok = read_pts(_filename, _data);
+    else if (ext == "bpc")             ok = read_bpc(_filename, _data);
+
+    // other formats are downsampled after reading
+    if (ok && reduce)
+    {
+        PointCloudData full;
+        std::swap(full, _data);
+        downsample(full.points.data(), full.normals.data(),
+                   full.has_colors ? full.colors.data() : nullptr,
+                   full.points.size(), _downsampling, _data);
+    }
+
+    return ok;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool write_point_cloud(const char* _filename,
+                       const std::vector<Point>&  _points,
+                       const std::vector<Normal>& _normals,
+                       const std::vector<Color>&  _colors)
+{
+    const uint64_t n = _points.size();
+    const bool has_normals = (_normals.size() == n);
+    const bool has_colors  = (_colors.size() == n);
+
+    // chunk table
+    std::vector<MappedPointCloud::Chunk> chunks;
+    chunks.push_back({ MappedPointCloud::Points, sizeof(Point), 0, n });
+    if (has_normals)
+        chunks.push_back({ MappedPointCloud::Normals, sizeof(Normal), 0, n });
+    if (has_colors)
+        chunks.push_back({ MappedPointCloud::Colors, sizeof(Color), 0, n });
+
+    const auto align = [](uint64_t o)
+    {
+        const uint64_t a = MappedPointCloud::alignment;
+        return (o + a-1) / a * a;
+    };
+
+    uint64_t offset = sizeof(MappedPointCloud::Header) + chunks.size()*sizeof(MappedPointCloud::Chunk);
+    for (auto& c : chunks)
+    {
+        c.offset = align(offset);
+        offset   = c.offset + c.count*c.element_size;
+    }
+
+    // header with bounding box
+    MappedPointCloud::Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MappedPointCloud::magic, sizeof(header.magic));
+    header.version  = MappedPointCloud::version;
+    header.n_chunks = chunks.size();
+    header.n_points = n;
+    header.has_bbox = (n > 0);
+    if (n > 0)
+    {
+        BoundingBox bb;
+        for (const auto& p : _points)
+            bb += p;
+        for (int i=0; i<3; ++i)
+        {
+            header.bbox_min[i] = bb.min()[i];
+            header.bbox_max[i] = bb.max()[i];
+        }
+    }
+
+    FILE* out = fopen(_filename, "wb");
+    if (!out) return false;
+
+    bool ok = true;
+    ok &= (fwrite(&header, sizeof(header), 1, out) == 1);
+    ok &= (fwrite(chunks.data(), sizeof(MappedPointCloud::Chunk), chunks.size(), out) == chunks.size());
+
+    uint64_t pos = sizeof(header) + chunks.size()*sizeof(MappedPointCloud::Chunk);
+    const char zeros[MappedPointCloud::alignment] = {};
+    for (const auto& c : chunks)
+    {
+        // pad to the chunk's aligned offset
+        ok &= (fwrite(zeros, 1, c.offset-pos, out) == c.offset-pos);
+
+        const void* src = (c.type == MappedPointCloud::Points)  ? (const void*)_points.data()  :
+                          (c.type == MappedPointCloud::Normals) ? (const void*)_normals.data() :
+                                                                  (const void*)_colors.data();
+        ok &= (fwrite(src, c.element_size, c.count, out) == c.count);
+        pos = c.offset + c.count*c.element_size;
+    }
+
+    ok &= (fclose(out) == 0);
+    return ok;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool convert_point_cloud(const char* _in_filename, const char* _out_filename)
+{
+    PointCloudData data;
+    if (!read_point_cloud(_in_filename, data))
+    {
+        std::cerr << "Cannot read " << _in_filename << std::endl;
+        return false;
+    }
+
+    if (!write_point_cloud(_out_filename, data.points, data.normals,
+                           data.has_colors ? data.colors : std::vector<Color>()))
+    {
+        std::cerr << "Cannot write " << _out_filename << std::endl;
+        return false;
+    }
+
+    std::cout << "Converted " << data.points.size() << " points to " << _out_filename << std::endl;
+    return true;
+}
+
+
+//=============================================================================
+
+
+MappedFile::
+MappedFile()
+: data_(nullptr), size_(0)
+{
+#ifdef _WIN32
+    file_handle_    = nullptr;
+    mapping_handle_ = nullptr;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+MappedFile::
+~MappedFile()
+{
+    close();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+MappedFile::
+open(const char* _filename)
+{
+    close();
+
+    // empty files cannot be mapped, but are valid
+    static const char empty[1] = { 0 };
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(_filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    file_handle_ = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) { close(); return false; }
+    if (size.QuadPart == 0) { data_ = empty; return true; }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    mapping_handle_ = mapping;
+    const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!data) { close(); return false; }
+    size_ = size.QuadPart;
+#else
+    int fd = ::open(_filename, O_RDONLY);
+    if (fd == -1) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+    if (st.st_size == 0) { ::close(fd); data_ = empty; return true; }
+
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+    size_ = st.st_size;
+#endif
+
+    data_ = (const char*)data;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+MappedFile::
+close()
+{
+#ifdef _WIN32
+    if (size_)           UnmapViewOfFile(data_);
+    if (mapping_handle_) CloseHandle((HANDLE)mapping_handle_);
+    if (file_handle_)    CloseHandle((HANDLE)file_handle_);
+    file_handle_    = nullptr;
+    mapping_handle_ = nullptr;
+#else
+    if (size_) munmap((void*)data_, size_);
+#endif
+
+    data_ = nullptr;
+    size_ = 0;
+}
+
+
+//=============================================================================
+
+
+// bytes per element of a chunk type, 0 for unknown types
+static uint32_t element_size(uint32_t _type)
+{
+    switch (_type)
+    {
+        case MappedPointCloud::Points:  return sizeof(pmp::Point);
+        case MappedPointCloud::Normals: return sizeof(pmp::Normal);
+        case MappedPointCloud::Colors:  return sizeof(pmp::Color);
+        default:                        return 0;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+MappedPointCloud::
+MappedPointCloud()
+: n_points_(0),
+  points_(nullptr), normals_(nullptr), colors_(nullptr),
+  has_bbox_(false)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+MappedPointCloud::
+~MappedPointCloud()
+{
+    close();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+MappedPointCloud::
+open(const char* _filename)
+{
+    close();
+
+    // map the whole file read-only
+    if (!file_.open(_filename))
+        return false;
+    const char*  data    = file_.data();
+    const size_t n_bytes = file_.size();
+
+
+    // validate header
+    const Header* header = (const Header*)data;
+    if (n_bytes < sizeof(Header) ||
+        memcmp(header->magic, magic, sizeof(magic)) != 0)
+    {
+        std::cerr << "MappedPointCloud: " << _filename << " is no .bpc file\n";
+        close();
+        return false;
+    }
+    if (header->version != version)
+    {
+        std::cerr << "MappedPointCloud: unsupported version " << header->version << std::endl;
+        close();
+        return false;
+    }
+
+
+    // validate chunk table
+    const Chunk* table = (const Chunk*)(data + sizeof(Header));
+    if (sizeof(Header) + (uint64_t)header->n_chunks*sizeof(Chunk) > n_bytes)
+    {
+        close();
+        return false;
+    }
+    for (uint32_t i=0; i<header->n_chunks; ++i)
+    {
+        const Chunk& c = table[i];
+
+        // known chunk types must have their element size, and all chunks
+        // must lie within the file (checked without overflowing)
+        const uint32_t type_size = element_size(c.type);
+        if (c.offset % alignment != 0 || c.count != header->n_points ||
+            c.element_size == 0 ||
+            (type_size && c.element_size != type_size) ||
+            c.offset > n_bytes ||
+            c.count > (n_bytes - c.offset) / c.element_size)
+        {
+            std::cerr << "MappedPointCloud: invalid chunk table\n";
+            close();
+            return false;
+        }
+    }
+
+
+    // point data in place
+    n_points_ = header->n_points;
+    points_   = (const Point*)  chunk(table, header->n_chunks, Points);
+    normals_  = (const Normal*) chunk(table, header->n_chunks, Normals);
+    colors_   = (const Color*)  chunk(table, header->n_chunks, Colors);
+    if (!points_)
+    {
+        std::cerr << "MappedPointCloud: no points chunk\n";
+        close();
+        return false;
+    }
+
+    has_bbox_ = header->has_bbox;
+    if (has_bbox_)
+    {
+        bbox_ = BoundingBox();
+        bbox_ += Point(header->bbox_min[0], header->bbox_min[1], header->bbox_min[2]);
+        bbox_ += Point(header->bbox_max[0], header->bbox_max[1], header->bbox_max[2]);
+    }
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+const void*
+MappedPointCloud::
+chunk(const Chunk* _table, uint32_t _n_chunks, uint32_t _type) const
+{
+    // element sizes were validated in open()
+    for (uint32_t i=0; i<_n_chunks; ++i)
+        if (_table[i].type == _type)
+            return file_.data() + _table[i].offset;
+
+    return nullptr;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+MappedPointCloud::
+close()
+{
+    file_.close();
+    n_points_ = 0;
+    points_   = nullptr;
+    normals_  = nullptr;
+    colors_   = nullptr;
+    has_bbox_ = false;
+}
+
+
+//=============================================================================
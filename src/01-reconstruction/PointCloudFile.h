@@ -0,0 +1,203 @@
+//=============================================================================
+//
+//   Exercise code for the lecture "Geometric Modeling"
+//   by Prof. Dr. Mario Botsch, TU Dortmund
+//
+//   Copyright (C) 2023 Computer Graphics Group, TU Dortmund.
+//
+//=============================================================================
+
+#pragma once
+
+#include <pmp/Types.h>
+#include <pmp/BoundingBox.h>
+#include <cstdint>
+#include <vector>
+
+//=============================================================================
+
+/// Contents of a point cloud file: points with normals and optional colors.
+struct PointCloudData
+{
+    std::vector<pmp::Point>  points;
+    std::vector<pmp::Normal> normals;
+    std::vector<pmp::Color>  colors;
+    bool has_colors = false;
+};
+
+
+/// Voxel-grid downsampling applied while a point cloud is read: all points
+/// in a voxel are replaced by their centroid, with averaged normal and color.
+struct VoxelDownsampling
+{
+    /// edge length of the voxels, 0 disables downsampling
+    float  voxel_size    = 0.0f;
+
+    /// memory for the voxel grid in bytes, 0 for no limit. Whenever the
+    /// grid exceeds it, the voxel size is doubled.
+    size_t memory_budget = 0;
+};
+
+
+/// Is \c _filename a point cloud format handled by read_point_cloud()?
+bool is_point_cloud_file(const char* _filename);
+
+/// Read a point cloud from a .xyz, .cnoff, .cxyz, .txt, .pts or .bpc file.
+/// Colors are filled with black if the file has none. Text and .bpc files
+/// are streamed through the voxel grid if \c _downsampling is enabled, such
+/// that only the reduced cloud is kept in memory.
+bool read_point_cloud(const char* _filename, PointCloudData& _data,
+                      const VoxelDownsampling& _downsampling = VoxelDownsampling());
+
+/// Write a point cloud to a binary .bpc file (see MappedPointCloud).
+/// Normals and colors are omitted if their size differs from the points.
+bool write_point_cloud(const char* _filename,
+                       const std::vector<pmp::Point>&  _points,
+                       const std::vector<pmp::Normal>& _normals,
+                       const std::vector<pmp::Color>&  _colors);
+
+/// Convert any point cloud read by read_point_cloud() to a .bpc file.
+bool convert_point_cloud(const char* _in_filename, const char* _out_filename);
+
+
+//=============================================================================
+
+/// A file mapped read-only into memory.
+class MappedFile
+{
+public:
+
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// map the whole file \c _filename
+    bool open(const char* _filename);
+
+    /// unmap the file
+    void close();
+
+    /// is a file mapped?
+    bool is_open() const { return data_ != nullptr; }
+
+    /// the file contents
+    const char* data() const { return data_; }
+
+    /// the file size in bytes
+    size_t size() const { return size_; }
+
+private:
+
+    const char*  data_;
+    size_t       size_;
+
+#ifdef _WIN32
+    void* file_handle_;
+    void* mapping_handle_;
+#endif
+};
+
+
+//=============================================================================
+
+/** \brief A point cloud in the binary .bpc format, memory-mapped read-only.
+
+    A .bpc file consists of a 64 byte header, a table of chunks, and the
+    chunk data. Every chunk is a contiguous array of points, normals or
+    colors, aligned to 64 bytes, such that it can be used in place after
+    mapping the file. Opening a file therefore costs no parsing or
+    copying, pages are loaded by the OS on first access.
+*/
+class MappedPointCloud
+{
+public:
+
+    /// file identification, first 8 bytes of the header
+    static constexpr char     magic[8] = { 'G','M','-','B','P','C','\r','\n' };
+
+    /// current version of the format
+    static constexpr uint32_t version = 1;
+
+    /// alignment of all chunks in the file
+    static constexpr uint64_t alignment = 64;
+
+    /// chunk types
+    enum ChunkType : uint32_t { Points = 1, Normals = 2, Colors = 3 };
+
+    /// file header
+    struct Header
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t n_chunks;    ///< number of entries in the chunk table
+        uint64_t n_points;
+        uint32_t has_bbox;    ///< are bbox_min/bbox_max valid?
+        uint32_t reserved;
+        float    bbox_min[3];
+        float    bbox_max[3];
+        uint64_t padding[1];
+    };
+
+    /// entry of the chunk table, which directly follows the header
+    struct Chunk
+    {
+        uint32_t type;          ///< see ChunkType
+        uint32_t element_size;  ///< bytes per element, e.g. 12 for float points
+        uint64_t offset;        ///< from the start of the file, aligned
+        uint64_t count;         ///< number of elements
+    };
+
+public:
+
+    MappedPointCloud();
+    ~MappedPointCloud();
+
+    MappedPointCloud(const MappedPointCloud&) = delete;
+    MappedPointCloud& operator=(const MappedPointCloud&) = delete;
+
+    /// map \c _filename and validate header and chunk table
+    bool open(const char* _filename);
+
+    /// unmap the file, all pointers become invalid
+    void close();
+
+    /// is a file mapped?
+    bool is_open() const { return file_.is_open(); }
+
+    /// number of points
+    size_t size() const { return n_points_; }
+
+    /// the points, in place in the mapped file
+    const pmp::Point*  points()  const { return points_; }
+
+    /// the normals, or nullptr if the file has none
+    const pmp::Normal* normals() const { return normals_; }
+
+    /// the colors, or nullptr if the file has none
+    const pmp::Color*  colors()  const { return colors_; }
+
+    /// does the header store a bounding box?
+    bool has_bounds() const { return has_bbox_; }
+
+    /// the bounding box stored in the header
+    pmp::BoundingBox bounds() const { return bbox_; }
+
+private:
+
+    const void* chunk(const Chunk* _table, uint32_t _n_chunks, uint32_t _type) const;
+
+    MappedFile   file_;
+    size_t       n_points_;
+
+    const pmp::Point*   points_;
+    const pmp::Normal*  normals_;
+    const pmp::Color*   colors_;
+
+    bool              has_bbox_;
+    pmp::BoundingBox  bbox_;
+};
+
+
+//=============================================================================
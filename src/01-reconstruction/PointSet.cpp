@@ -12,8 +12,7 @@
 #include <pmp/algorithms/SurfaceNormals.h>
 
 // system includes
-#include <fstream>
-#include <string>
+#include <algorithm>
 #include <clocale>
 
 using namespace pmp;
@@ -21,26 +20,6 @@ using namespace pmp;
 //=============================================================================
 
 
-// helper function from PMP
-template <typename T>
-void tfread(FILE* in, const T& t)
-{
-    size_t n_items = fread((char*)&t, 1, sizeof(t), in);
-    assert(n_items > 0);
-}
-
-// helper function from PMP
-template <typename T>
-void tfwrite(FILE* out, const T& t)
-{
-    size_t n_items = fwrite((char*)&t, 1, sizeof(t), out);
-    assert(n_items > 0);
-}
-
-
-//-----------------------------------------------------------------------------
-
-
 PointSet::PointSet()
     :SurfaceMeshGL()
 {
@@ -51,35 +30,32 @@ PointSet::PointSet()
 //-----------------------------------------------------------------------------
 
 
-bool PointSet::read_data(const char *_filename)
+bool PointSet::read_data(const char *_filename, const VoxelDownsampling& _downsampling)
 {
     std::setlocale(LC_NUMERIC, "C");
 
-    // extract file extension
-    std::string filename(_filename);
-    std::string::size_type dot(filename.rfind("."));
-    std::string ext = filename.substr(dot+1, filename.length()-dot-1);
-    std::transform(ext.begin(), ext.end(), ext.begin(), tolower);
-
     bool ok = false;
-    if (ext == "xyz")
+    if (is_point_cloud_file(_filename))
     {
-        ok = read_xyz(_filename);
-        has_colors_ = false;
-    }
-    else if (ext == "cnoff")
-    {
-        ok = read_cnoff(_filename);
-        has_colors_ = true;
-    }
-    else if (ext == "txt")
-    {
-        ok = read_txt(_filename);
-        has_colors_ = true;
-    }
-    else if (ext == "pts")
-    {
-        ok = read_pts(_filename);
+        PointCloudData data;
+        ok = read_point_cloud(_filename, data, _downsampling);
+        points_     = std::move(data.points);
+        normals_    = std::move(data.normals);
+        colors_     = std::move(data.colors);
+        has_colors_ = data.has_colors;
+
+        // normals and colors are copied into vertex properties of the
+        // points' size below, reject files with inconsistent arrays
+        if (normals_.size() != points_.size() ||
+            (has_colors_ && colors_.size() != points_.size()))
+        {
+            std::cerr << "Inconsistent number of normals/colors in "
+                      << _filename << std::endl;
+            points_.clear();
+            normals_.clear();
+            colors_.clear();
+            ok = false;
+        }
     }
     else
     {
@@ -113,21 +89,19 @@ bool PointSet::read_data(const char *_filename)
 
     if (!ok)
     {
-        std::cerr << "Cannot read " << filename << std::endl;
+        std::cerr << "Cannot read " << _filename << std::endl;
         return false;
     }
 
     clear();
+    reserve(points_.size(), 0, 0);
     for(size_t i = 0; i < points_.size(); i++)
     {
         add_vertex(points_[i]);
     }
 
     auto vnormal = vertex_property<Normal>("v:normal");
-    for(auto v : vertices())
-    {
-        vnormal[v] = normals_[v.idx()];
-    }
+    std::copy(normals_.begin(), normals_.end(), vnormal.vector().begin());
 
     set_specular(0.15);
     if(!has_colors_)
@@ -139,10 +113,7 @@ bool PointSet::read_data(const char *_filename)
     else
     {
         auto vcolor = vertex_property<Color>("v:color");
-        for(auto v : vertices())
-        {
-            vcolor[v] = colors_[v.idx()];
-        }
+        std::copy(colors_.begin(), colors_.end(), vcolor.vector().begin());
     }
 
     set_point_size(3);
@@ -173,175 +144,10 @@ void PointSet::update_opengl()
 //-----------------------------------------------------------------------------
 
 
-bool
-PointSet::
-read_xyz(const char* filename)
-{
-    FILE* in = fopen(filename, "r");
-    if (!in) return false;
-
-    char line[200];
-    float x, y, z;
-    float nx, ny, nz;
-    int n;
-
-    points_.clear();
-    normals_.clear();
-    colors_.clear();
-
-    while (in && !feof(in) && fgets(line, 200, in))
-    {
-        n = sscanf(line, "%f %f %f %f %f %f", &x, &y, &z, &nx, &ny, &nz);
-        if (n >= 6)
-        {
-            points_.push_back(pmp::Point(x,y,z));
-            normals_.push_back(pmp::Normal(nx,ny,nz));
-            colors_.push_back(pmp::Color(0.0,0.0,0.0));
-        }
-    }
-
-    fclose(in);
-    return true;
-}
-
-
-//-----------------------------------------------------------------------------
-
-
-bool
-PointSet::
-read_cnoff(const char* filename)
+bool PointSet::write_bpc(const char* _filename) const
 {
-    FILE* in = fopen(filename, "r");
-    if (!in) return false;
-
-    char line[200];
-    float x, y, z;
-    float nx, ny, nz;
-    float cx, cy, cz;
-    int n;
-
-    points_.clear();
-    normals_.clear();
-    colors_.clear();
-
-    while (in && !feof(in) && fgets(line, 200, in))
-    {
-        n = sscanf(line, "%f %f %f %f %f %f %f %f %f", &x, &y, &z, &nx, &ny, &nz, &cx, &cy, &cz);
-        if (n >= 9)
-        {
-            points_.push_back(pmp::Point(x,y,z));
-            normals_.push_back(pmp::Normal(nx,ny,nz));
-            colors_.push_back(pmp::Color(cx/255.0,cy/255.0,cz/255.0));
-        }
-    }
-
-    fclose(in);
-    return true;
-}
-
-
-//-----------------------------------------------------------------------------
-
-
-bool
-PointSet::
-read_cxyz(const char* filename)
-{
-    std::ifstream ifs(filename);
-    if (!ifs) return false;
-
-    float x, y, z;
-    float nx, ny, nz;
-    float cx, cy, cz;
-
-    points_.clear();
-    normals_.clear();
-    colors_.clear();
-
-    std::string dummy;
-    std::getline(ifs, dummy);
-    std::getline(ifs, dummy);
-    while (ifs && !ifs.eof())
-    {
-        ifs >> x >> y >> z;
-        ifs >> nx >> ny >> nz;
-        ifs >> cx >> cy >> cz;
-        points_.push_back(pmp::Point(x,y,z));
-        normals_.push_back(pmp::Normal(nx,ny,nz));
-        colors_.push_back(pmp::Color(cx,cy,cz));
-    }
-
-    ifs.close();
-
-    return true;
-}
-
-
-//-----------------------------------------------------------------------------
-
-
-bool
-PointSet::
-read_txt(const char* filename)
-{
-    FILE* in = fopen(filename, "r");
-    if (!in) return false;
-
-    char line[200];
-    float x, y, z;
-    float nx, ny, nz;
-    float cx, cy, cz;
-    int n;
-
-    points_.clear();
-    normals_.clear();
-    colors_.clear();
-
-    while (in && !feof(in) && fgets(line, 200, in))
-    {
-        n = sscanf(line, "%f %f %f %f %f %f %f %f %f", &x, &y, &z, &cx, &cy, &cz, &nx, &ny, &nz);
-        if (n >= 9)
-        {
-            points_.push_back(pmp::Point(x,y,z));
-            normals_.push_back(pmp::Normal(nx,ny,nz));
-            colors_.push_back(pmp::Color(cx/255.0,cy/255.0,cz/255.0));
-        }
-    }
-
-    fclose(in);
-    return true;
-}
-
-
-//-----------------------------------------------------------------------------
-
-
-bool
-PointSet::
-read_pts(const char* filename)
-{
-    FILE* in = fopen(filename, "rb");
-    if (!in) return false;
-
-    unsigned int n;
-    tfread(in, n);
-    tfread(in, has_colors_);
-
-    std::cout << n << " points " << (has_colors_ ? "with" : "without") << " colors\n";
-
-    points_.resize(n);
-    fread((char*)points_.data(), sizeof(pmp::Point), n, in);
-
-    normals_.resize(n);
-    fread((char*)normals_.data(), sizeof(pmp::Normal), n, in);
-
-    colors_.resize(n, pmp::Color(0,0,0));
-    if (has_colors_)
-        fread((char*)colors_.data(), sizeof(pmp::Color), n, in);
-
-    fclose(in);
-    return true;
+    return write_point_cloud(_filename, points_, normals_,
+                             has_colors_ ? colors_ : std::vector<Color>());
 }
 
 
@@ -10,6 +10,7 @@
 #pragma once
 
 // our includes
+#include "PointCloudFile.h"
 #include <pmp/Types.h>
 #include <pmp/visualization/SurfaceMeshGL.h>
 
@@ -25,8 +26,14 @@ public:
     /// constructor
     PointSet();
 
-    /// encapsulates read functions
-    bool read_data(const char* _filename);
+    /// encapsulates read functions, see read_point_cloud() for the point
+    /// set formats; other files are read as meshes. Point sets are reduced
+    /// by \c _downsampling while they are read.
+    bool read_data(const char* _filename,
+                   const VoxelDownsampling& _downsampling = VoxelDownsampling());
+
+    /// write points, normals and colors to a binary .bpc file
+    bool write_bpc(const char* _filename) const;
 
     /// resets points and normals to original
     void reset();
@@ -34,23 +41,6 @@ public:
     /// copies point cloud data to Surfacemesh for openGL rendering
     void update_opengl();
 
-private:
-
-    /// Read a point set with normals from a .xyz file.
-    bool read_xyz(const char* filename);
-
-    /// Read a point set with normals and colors from a .cnoff file.
-    bool read_cnoff(const char* filename);
-
-    /// Read a point set with normals and colors from a .cxyz file.
-    bool read_cxyz(const char* filename);
-
-    /// Read a point set with normals and colors from a .txt file.
-    bool read_txt(const char* filename);
-
-    /// Read a point set with normals and colors from a binary .pts file.
-    bool read_pts(const char* filename);
-
 public:
 
     std::vector<pmp::Point>  points_;
@@ -0,0 +1,76 @@
+//=============================================================================
+//
+//   Exercise code for the lecture "Geometric Modeling"
+//   by Prof. Dr. Mario Botsch, TU Dortmund
+//
+//   Copyright (C) 2023 Computer Graphics Group, TU Dortmund.
+//
+//=============================================================================
+
+#include "SparseGrid.h"
+using namespace pmp;
+
+
+//== IMPLEMENTATION ==========================================================
+
+
+SparseGrid::
+SparseGrid(const vec3&  _origin,
+           const vec3&  _x_axis,
+           const vec3&  _y_axis,
+           const vec3&  _z_axis,
+           unsigned int  _x_res,
+           unsigned int  _y_res,
+           unsigned int  _z_res)
+{
+    // store bounding box
+    origin_ = _origin;
+    x_axis_ = _x_axis;
+    y_axis_ = _y_axis;
+    z_axis_ = _z_axis;
+
+    // store grid resolution
+    x_res_ = _x_res;
+    y_res_ = _y_res;
+    z_res_ = _z_res;
+
+    // spacing
+    dx_ = x_axis_ / (float)(x_res_-1);
+    dy_ = y_axis_ / (float)(y_res_-1);
+    dz_ = z_axis_ / (float)(z_res_-1);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+unsigned int
+SparseGrid::
+allocate_brick(unsigned int bx, unsigned int by, unsigned int bz)
+{
+    auto it = brick_map_.emplace(key(bx,by,bz), brick_coords_.size());
+
+    // new brick: append coordinates and values
+    if (it.second)
+    {
+        brick_coords_.push_back(ivec3(bx,by,bz));
+        values_.resize(values_.size() + brick_nodes, 0.0);
+    }
+
+    return it.first->second;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+int
+SparseGrid::
+brick(unsigned int bx, unsigned int by, unsigned int bz) const
+{
+    auto it = brick_map_.find(key(bx,by,bz));
+    return (it == brick_map_.end()) ? -1 : (int)it->second;
+}
+
+
+//=============================================================================
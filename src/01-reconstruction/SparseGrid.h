@@ -0,0 +1,128 @@
+//=============================================================================
+//
+//   Exercise code for the lecture "Geometric Modeling"
+//   by Prof. Dr. Mario Botsch, TU Dortmund
+//
+//   Copyright (C) 2023 Computer Graphics Group, TU Dortmund.
+//
+//=============================================================================
+
+#pragma once
+
+#include <pmp/MatVec.h>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+using namespace pmp;
+
+//=============================================================================
+
+/** Sparse variant of Grid: a 3D regular grid of float values that only
+    stores values for selected regions. The grid is partitioned into bricks
+    of brick_size^3 nodes, which are allocated on demand and found through a
+    hash map. Useful for narrow-band distance fields, where only the nodes
+    close to the surface are needed. */
+class SparseGrid
+{
+public:
+
+    /// number of grid nodes per brick along each axis
+    static constexpr unsigned int brick_size = 8;
+
+    /// number of grid nodes per brick
+    static constexpr unsigned int brick_nodes = brick_size*brick_size*brick_size;
+
+
+    /** construct grid with origin and three axes of bounding box, as well as
+        with the grid resolution in x, y, z direction. No bricks are allocated. */
+    SparseGrid(const vec3&  _origin = vec3(0,0,0),
+               const vec3&  _x_axis = vec3(1,0,0),
+               const vec3&  _y_axis = vec3(0,1,0),
+               const vec3&  _z_axis = vec3(0,0,1),
+               unsigned int  _x_res = 10,
+               unsigned int  _y_res = 10,
+               unsigned int  _z_res = 10);
+
+
+    /// return grid's origin
+    const vec3& origin() const { return origin_; }
+    /// return grid's x-axis
+    const vec3& x_axis() const { return x_axis_; }
+    /// return grid's y-axis
+    const vec3& y_axis() const { return y_axis_; }
+    /// return grid's z-axis
+    const vec3& z_axis() const { return z_axis_; }
+
+    /// return grid's x-resolution
+    unsigned int x_resolution() const { return x_res_; }
+    /// return grid's y-resolution
+    unsigned int y_resolution() const { return y_res_; }
+    /// return grid's z-resolution
+    unsigned int z_resolution() const { return z_res_; }
+
+
+    /// return position of grid point at index (x,y,z)
+    vec3 point(unsigned int x, unsigned int y, unsigned int z) const {
+        return origin_ + dx_*x + dy_*y + dz_*z;
+    }
+    /// return position of grid point at index xyz
+    vec3 point(const ivec3& xyz) const {
+        return origin_ + dx_*xyz[0] + dy_*xyz[1] + dz_*xyz[2];
+    }
+
+
+    /// allocate brick (bx,by,bz) if necessary, return its index
+    unsigned int allocate_brick(unsigned int bx, unsigned int by, unsigned int bz);
+
+    /// return index of brick (bx,by,bz), or -1 if it is not allocated
+    int brick(unsigned int bx, unsigned int by, unsigned int bz) const;
+
+    /// return number of allocated bricks
+    unsigned int n_bricks() const { return brick_coords_.size(); }
+
+    /// return coordinates (bx,by,bz) of brick b
+    const ivec3& brick_coordinates(unsigned int b) const { return brick_coords_[b]; }
+
+    /// return index of node (x,y,z) inside its brick
+    static unsigned int local_index(unsigned int x, unsigned int y, unsigned int z) {
+        return z%brick_size + (y%brick_size)*brick_size + (x%brick_size)*brick_size*brick_size;
+    }
+
+    /// return the values of brick b, indexed by local_index()
+    float* brick_values(unsigned int b) { return &values_[b*brick_nodes]; }
+    /// return the values of brick b, indexed by local_index()
+    const float* brick_values(unsigned int b) const { return &values_[b*brick_nodes]; }
+
+
+    /// is the brick containing grid node (x,y,z) allocated?
+    bool is_allocated(unsigned int x, unsigned int y, unsigned int z) const {
+        return brick(x/brick_size, y/brick_size, z/brick_size) != -1;
+    }
+
+    /// return reference to scalar value at (allocated) grid node (x,y,z)
+    float& operator()(unsigned int x, unsigned int y, unsigned int z) {
+        return brick_values(brick(x/brick_size, y/brick_size, z/brick_size))[local_index(x,y,z)];
+    }
+    /// return scalar value at (allocated) grid node (x,y,z)
+    float operator()(unsigned int x, unsigned int y, unsigned int z) const {
+        return brick_values(brick(x/brick_size, y/brick_size, z/brick_size))[local_index(x,y,z)];
+    }
+
+
+private:
+
+    /// hash key of brick (bx,by,bz)
+    static uint64_t key(unsigned int bx, unsigned int by, unsigned int bz) {
+        return (uint64_t)bx | ((uint64_t)by << 21) | ((uint64_t)bz << 42);
+    }
+
+    vec3                origin_, x_axis_, y_axis_, z_axis_, dx_, dy_, dz_;
+    unsigned int        x_res_, y_res_, z_res_;
+
+    std::unordered_map<uint64_t, unsigned int>  brick_map_;
+    std::vector<ivec3>  brick_coords_;
+    std::vector<float>  values_;
+};
+
+//=============================================================================
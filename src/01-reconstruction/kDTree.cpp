@@ -8,8 +8,12 @@
 //=============================================================================
 
 #include "kDTree.h"
+#include <pmp/Timer.h>
 #include <algorithm>
 #include <float.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace pmp;
 
@@ -17,29 +21,65 @@ using namespace pmp;
 
 
 unsigned int
-kDTree::build(unsigned int _max_handles, unsigned int _max_depth)
+kDTree::build(unsigned int _max_handles, unsigned int _max_depth, SplitRule _rule)
 {
+    Timer timer;
+    timer.start();
+
     // copy points to element array
+    const int n = points_.size();
     elements_.clear();
-    elements_.reserve(points_.size());
-    ConstPointIter p_it;
-    int i;
+    elements_.resize(n, Element(Point(0,0,0), 0));
+
+#pragma omp parallel for
+    for (int i=0; i<n; ++i)
+        elements_[i] = Element(points_[i], i);
+
+
+    // init root with bounding box of all points
+    nodes_.clear();
+    nodes_.emplace_back(0, n);
+    Point bb_min(0,0,0), bb_max(0,0,0);
+    if (n)
+    {
+        bb_min = bb_max = points_[0];
+        for (ConstPointIter p_it=points_.begin(); p_it!=points_.end(); ++p_it)
+        {
+            bb_min = min(bb_min, *p_it);
+            bb_max = max(bb_max, *p_it);
+        }
+    }
+
 
-    for (p_it=points_.begin(), i=0; p_it!=points_.end(); ++p_it, ++i)
-        elements_.push_back( Element(*p_it, i) );
+    // call recursive helper, depth is limited by the traversal stack
+#pragma omp parallel
+#pragma omp single
+    _build(nodes_, 0, bb_min, bb_max, _max_handles,
+           std::min(_max_depth, max_depth_-1), _rule);
 
 
-    // init
-    delete root_;
-    root_ = new Node(elements_.begin(), elements_.end());
-    n_nodes_ = 0;
+    // copy elements in tree order to leaf arrays
+    x_.resize(n);
+    y_.resize(n);
+    z_.resize(n);
+    idx_.resize(n);
 
+#pragma omp parallel for
+    for (int i=0; i<n; ++i)
+    {
+        x_[i]   = elements_[i].point[0];
+        y_[i]   = elements_[i].point[1];
+        z_[i]   = elements_[i].point[2];
+        idx_[i] = elements_[i].idx;
+    }
+    Elements().swap(elements_);
 
-    // call recursive helper
-    _build(root_, _max_handles, _max_depth);
 
+    timer.stop();
+    _compute_statistics();
+    stats_.time = timer.elapsed();
 
-    return n_nodes_;
+    return nodes_.size();
 }
 
 
@@ -48,11 +88,18 @@ kDTree::build(unsigned int _max_handles, unsigned int _max_depth)
 
 void
 kDTree::
-_build(Node*         _node,
+_build(Nodes&        _nodes,
+       unsigned int  _node,
+       Point         _bb_min,
+       Point         _bb_max,
        unsigned int  _max_handles,
-       unsigned int  _depth)
+       unsigned int  _depth,
+       SplitRule     _rule)
 {
-    const unsigned int n = _node->end_-_node->begin_;
+    // copy range, _nodes might be re-allocated below
+    const unsigned int begin = _nodes[_node].begin_;
+    const unsigned int end   = _nodes[_node].end_;
+    const unsigned int n     = end-begin;
 
 
     // should we stop at this level ?
@@ -60,44 +107,243 @@ _build(Node*         _node,
         return;
 
 
-    // compute bounding box
-    ElementIter it(_node->begin_);
-    Point bb_min = it->point;
-    Point bb_max = it->point;
-    for (; it!=_node->end_; ++it)
+    ElementIter first(elements_.begin()+begin), last(elements_.begin()+end), it;
+
+
+    // the midpoint rule uses the bounding box of the points, not of the cell
+    if (_rule == MidpointSplit)
     {
-        bb_min = min(bb_min, it->point);
-        bb_max = max(bb_max, it->point);
+        _bb_min = _bb_max = first->point;
+        for (it=first; it!=last; ++it)
+        {
+            _bb_min = min(_bb_min, it->point);
+            _bb_max = max(_bb_max, it->point);
+        }
     }
 
 
     // split longest side of bounding box
-    Point bb = bb_max - bb_min;
+    Point bb = _bb_max - _bb_min;
     Scalar length = bb[0];
     int axis = 0;
     if (bb[1] > length) length = bb[axis=1];
     if (bb[2] > length) length = bb[axis=2];
-    Scalar cv = 0.5*(bb_min[axis]+bb_max[axis]);
+    Scalar cv;
+
+
+    // partition for left and right child
+    if (_rule == MidpointSplit)
+    {
+        cv = 0.5*(_bb_min[axis]+_bb_max[axis]);
+        it = std::partition(first, last, PartPlane(axis, cv));
+    }
+    else
+    {
+        it = first + n/2;
+        std::nth_element(first, it, last, AxisGreater(axis));
+        cv = it->point[axis];
+    }
+    const unsigned int mid = it-elements_.begin();
 
 
     // store cut dimension and value
-    _node->cut_dim_ = axis;
-    _node->cut_val_ = cv;
+    _nodes[_node].cut_dim_ = axis;
+    _nodes[_node].cut_val_ = cv;
 
 
-    // partition for left and right child
-    it = std::partition(_node->begin_, _node->end_, PartPlane(axis, cv));
+    // cells of the children
+    Point left_min(_bb_min), right_max(_bb_max);
+    left_min[axis]  = cv;
+    right_max[axis] = cv;
+
+
+    // large subtrees: build children as parallel tasks into separate arrays
+    if (n >= parallel_threshold_)
+    {
+        Nodes left(1, Node(begin, mid)), right(1, Node(mid, end));
+
+#pragma omp task shared(left)
+        _build(left, 0, left_min, _bb_max, _max_handles, _depth-1, _rule);
+
+#pragma omp task shared(right)
+        _build(right, 0, _bb_min, right_max, _max_handles, _depth-1, _rule);
+
+#pragma omp taskwait
+        _splice(_nodes, _node, left, right);
+    }
+
+    // small subtrees: create children next to each other and recurse
+    else
+    {
+        const unsigned int child = _nodes.size();
+        _nodes[_node].child_ = child;
+        _nodes.emplace_back(begin, mid);
+        _nodes.emplace_back(mid, end);
+
+        _build(_nodes, child,   left_min, _bb_max,  _max_handles, _depth-1, _rule);
+        _build(_nodes, child+1, _bb_min, right_max, _max_handles, _depth-1, _rule);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+kDTree::
+_splice(Nodes&        _nodes,
+        unsigned int  _node,
+        const Nodes&  _left,
+        const Nodes&  _right)
+{
+    // the two roots go next to each other, followed by the rest of the left
+    // and then the right subtree. Node i>0 of the left subtree moves to
+    // left_base+i, node i>0 of the right subtree to right_base+i.
+    const unsigned int child      = _nodes.size();
+    const unsigned int left_base  = child + 1;
+    const unsigned int right_base = child + _left.size();
+
+    _nodes[_node].child_ = child;
+    _nodes.reserve(child + _left.size() + _right.size());
+
+    _nodes.push_back(_left[0]);
+    _nodes.push_back(_right[0]);
+    if (_nodes[child].child_)   _nodes[child].child_   += left_base;
+    if (_nodes[child+1].child_) _nodes[child+1].child_ += right_base;
+
+    for (unsigned int i=1; i<_left.size(); ++i)
+    {
+        _nodes.push_back(_left[i]);
+        if (_nodes.back().child_) _nodes.back().child_ += left_base;
+    }
+    for (unsigned int i=1; i<_right.size(); ++i)
+    {
+        _nodes.push_back(_right[i]);
+        if (_nodes.back().child_) _nodes.back().child_ += right_base;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+kDTree::
+_compute_statistics()
+{
+    stats_.n_nodes       = nodes_.size();
+    stats_.n_leaves      = 0;
+    stats_.min_depth     = nodes_.empty() ? 0 : max_depth_;
+    stats_.max_depth     = 0;
+    stats_.avg_depth     = 0.0;
+    stats_.max_leaf_size = 0;
+
+    if (nodes_.empty())
+        return;
+
+    // depth-first traversal with explicit stack of (node, depth)
+    std::vector< std::pair<unsigned int, unsigned int> > stack;
+    stack.emplace_back(0, 0);
+    while (!stack.empty())
+    {
+        const unsigned int node  = stack.back().first;
+        const unsigned int depth = stack.back().second;
+        stack.pop_back();
+
+        const Node& nd = nodes_[node];
+        if (nd.child_)
+        {
+            stack.emplace_back(nd.child_,   depth+1);
+            stack.emplace_back(nd.child_+1, depth+1);
+        }
+        else
+        {
+            const unsigned int size = nd.end_ - nd.begin_;
+            ++stats_.n_leaves;
+            stats_.min_depth     = std::min(stats_.min_depth, depth);
+            stats_.max_depth     = std::max(stats_.max_depth, depth);
+            stats_.max_leaf_size = std::max(stats_.max_leaf_size, size);
+            stats_.avg_depth    += (double)depth * size;
+        }
+    }
+
+    if (!x_.empty())
+        stats_.avg_depth /= x_.size();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Data>
+void
+kDTree::
+_search(Data& _data) const
+{
+    if (nodes_.empty())
+        return;
+
+    // Far children that still have to be visited, together with the squared
+    // distance of their cell to the query point. There is at most one per
+    // level. The cell distance is accumulated incrementally from the
+    // per-dimension offsets to the cell (Arya & Mount).
+    struct StackEntry
+    {
+        unsigned int node;
+        Scalar       dist;
+        Scalar       off[3];
+    };
+    StackEntry stack[max_depth_];
+    unsigned int top = 0;
+
+    unsigned int node = 0;
+    Scalar dist = 0.0;
+    Scalar off[3] = { 0.0, 0.0, 0.0 };
+    for (;;)
+    {
+        const Node& nd = nodes_[node];
+
+        // inner node: descend into near child, remember far child
+        if (nd.child_)
+        {
+            const int cd = nd.cut_dim_;
+            Scalar o = _data.ref[cd] - nd.cut_val_;
+            unsigned int near_child = (o > 0.0) ? nd.child_ : nd.child_+1;
+            unsigned int far_child  = (o > 0.0) ? nd.child_+1 : nd.child_;
 
+            Scalar far_dist = dist - off[cd]*off[cd] + o*o;
+            if (far_dist <= _data.dist)
+            {
+                StackEntry& e = stack[top++];
+                e.node = far_child;
+                e.dist = far_dist;
+                e.off[0] = off[0]; e.off[1] = off[1]; e.off[2] = off[2];
+                e.off[cd] = o;
+            }
 
-    // create children
-    n_nodes_ += 2;
-    _node->left_child_  = new Node(_node->begin_, it);
-    _node->right_child_ = new Node(it, _node->end_);
+            node = near_child;
+            continue;
+        }
 
+        // terminal node
+        ++_data.leaf_tests;
+        _scan_leaf(nd, _data);
 
-    // recurse to childen
-    _build(_node->left_child_,  _max_handles, _depth-1);
-    _build(_node->right_child_, _max_handles, _depth-1);
+        // continue with the most recently deferred far child that is still in
+        // range (the stack is LIFO, not ordered by distance)
+        for (;;)
+        {
+            if (!top) return;
+            const StackEntry& e = stack[--top];
+            if (e.dist <= _data.dist)
+            {
+                node = e.node;
+                dist = e.dist;
+                off[0] = e.off[0]; off[1] = e.off[1]; off[2] = e.off[2];
+                break;
+            }
+        }
+    }
 }
 
 
@@ -112,10 +358,11 @@ nearest(const Point& _p) const
     NearestNeighborData  data;
     data.ref        = _p;
     data.dist       = FLT_MAX;
+    data.nearest    = -1;
     data.leaf_tests = 0;
 
-    // recursive search
-    _nearest(root_, data);
+    // iterative search
+    _search(data);
 
     // dist was computed as sqr-dist
     data.dist = sqrt(data.dist);
@@ -129,48 +376,247 @@ nearest(const Point& _p) const
 
 void
 kDTree::
-_nearest(Node* _node, NearestNeighborData& _data) const
+_scan_leaf(const Node& _node, NearestNeighborData& _data) const
 {
-    if (_node->left_child_)
+    const Scalar rx = _data.ref[0], ry = _data.ref[1], rz = _data.ref[2];
+    Scalar dist[leaf_block_];
+
+    for (unsigned int b=_node.begin_; b<_node.end_; b+=leaf_block_)
     {
-        int cd = _node->cut_dim_;
-        Scalar off = _data.ref[cd] - _node->cut_val_;
+        const unsigned int n = std::min(leaf_block_, _node.end_-b);
 
-        if (off > 0.0)
+        // squared distances of one block, vectorizes on SoA data
+        for (unsigned int i=0; i<n; ++i)
         {
-            _nearest(_node->left_child_, _data);
-            if (off*off < _data.dist)
+            const Scalar dx = x_[b+i]-rx, dy = y_[b+i]-ry, dz = z_[b+i]-rz;
+            dist[i] = dx*dx + dy*dy + dz*dz;
+        }
+
+        for (unsigned int i=0; i<n; ++i)
+        {
+            if (dist[i] < _data.dist)
             {
-                _nearest(_node->right_child_, _data);
+                _data.dist    = dist[i];
+                _data.nearest = idx_[b+i];
             }
         }
-        else
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+unsigned int
+kDTree::
+k_nearest(const Point&          _p,
+          unsigned int          _k,
+          std::vector<int>&     _indices,
+          std::vector<Scalar>&  _dists) const
+{
+    // init data
+    KNearestNeighborData  data;
+    data.ref        = _p;
+    data.k          = _k;
+    data.dist       = FLT_MAX;
+    data.leaf_tests = 0;
+    data.heap.reserve(_k);
+
+    // iterative search
+    if (_k) _search(data);
+
+    // sort by increasing distance, dist was computed as sqr-dist
+    std::sort_heap(data.heap.begin(), data.heap.end());
+    const unsigned int n = data.heap.size();
+    _indices.resize(n);
+    _dists.resize(n);
+    for (unsigned int i=0; i<n; ++i)
+    {
+        _dists[i]   = sqrt(data.heap[i].first);
+        _indices[i] = data.heap[i].second;
+    }
+
+    return n;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+kDTree::
+k_nearest(KNearestNeighborData& _data) const
+{
+    _data.leaf_tests = 0;
+    _data.heap.clear();
+
+    // iterative search
+    if (_data.k) _search(_data);
+
+    // sort by increasing distance
+    std::sort_heap(_data.heap.begin(), _data.heap.end());
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+kDTree::
+k_nearest(const Points&  _queries,
+          unsigned int   _k,
+          int*           _indices,
+          Scalar*        _dists) const
+{
+    if (!_k) return;
+
+    const int n = _queries.size();
+
+#pragma omp parallel
+    {
+        // each thread re-uses its own heap
+        KNearestNeighborData  data;
+        data.k = _k;
+        data.heap.reserve(_k);
+
+#pragma omp for schedule(dynamic, 256)
+        for (int i=0; i<n; ++i)
         {
-            _nearest(_node->right_child_, _data);
-            if (off*off < _data.dist)
+            data.ref        = _queries[i];
+            data.dist       = FLT_MAX;
+            data.leaf_tests = 0;
+            data.heap.clear();
+
+            _search(data);
+
+            // sort by increasing distance, dist was computed as sqr-dist
+            std::sort_heap(data.heap.begin(), data.heap.end());
+            int*    idx = _indices + (size_t)i*_k;
+            Scalar* dst = _dists ? _dists + (size_t)i*_k : nullptr;
+            for (unsigned int j=0; j<_k; ++j)
             {
-                _nearest(_node->left_child_, _data);
+                if (j < data.heap.size())
+                {
+                    idx[j] = data.heap[j].second;
+                    if (dst) dst[j] = sqrt(data.heap[j].first);
+                }
+                else
+                {
+                    idx[j] = -1;
+                    if (dst) dst[j] = FLT_MAX;
+                }
             }
         }
     }
+}
 
-    // terminal node
-    else
+
+//-----------------------------------------------------------------------------
+
+
+void
+kDTree::
+_scan_leaf(const Node& _node, KNearestNeighborData& _data) const
+{
+    const Scalar rx = _data.ref[0], ry = _data.ref[1], rz = _data.ref[2];
+    Scalar dist[leaf_block_];
+
+    for (unsigned int b=_node.begin_; b<_node.end_; b+=leaf_block_)
     {
-        ++_data.leaf_tests;
-        Scalar dist;
+        const unsigned int n = std::min(leaf_block_, _node.end_-b);
+
+        // squared distances of one block, vectorizes on SoA data
+        for (unsigned int i=0; i<n; ++i)
+        {
+            const Scalar dx = x_[b+i]-rx, dy = y_[b+i]-ry, dz = z_[b+i]-rz;
+            dist[i] = dx*dx + dy*dy + dz*dz;
+        }
 
-        for (ElementIter it=_node->begin_; it!=_node->end_; ++it)
+        for (unsigned int i=0; i<n; ++i)
         {
-            dist = sqrnorm(it->point - _data.ref);
-            if (dist < _data.dist)
+            // heap not full yet: insert if within search radius
+            if (_data.heap.size() < _data.k)
+            {
+                if (dist[i] > _data.dist) continue;
+                _data.heap.emplace_back(dist[i], idx_[b+i]);
+                std::push_heap(_data.heap.begin(), _data.heap.end());
+                if (_data.heap.size() == _data.k)
+                    _data.dist = _data.heap.front().first;
+            }
+
+            // replace the current k-th neighbor
+            else if (dist[i] < _data.dist)
             {
-                _data.dist    = dist;
-                _data.nearest = it->idx;
+                std::pop_heap(_data.heap.begin(), _data.heap.end());
+                _data.heap.back() = std::make_pair(dist[i], idx_[b+i]);
+                std::push_heap(_data.heap.begin(), _data.heap.end());
+                _data.dist = _data.heap.front().first;
             }
         }
     }
 }
 
 
+//-----------------------------------------------------------------------------
+
+
+unsigned int
+kDTree::
+radius(const Point&          _p,
+       Scalar                _r,
+       std::vector<int>&     _indices,
+       std::vector<Scalar>&  _dists) const
+{
+    // init data
+    RadiusNeighborData  data;
+    data.ref        = _p;
+    data.dist       = _r*_r;
+    data.leaf_tests = 0;
+
+    // iterative search
+    _search(data);
+
+    // sort by increasing distance, dist was computed as sqr-dist
+    std::sort(data.neighbors.begin(), data.neighbors.end());
+    const unsigned int n = data.neighbors.size();
+    _indices.resize(n);
+    _dists.resize(n);
+    for (unsigned int i=0; i<n; ++i)
+    {
+        _dists[i]   = sqrt(data.neighbors[i].first);
+        _indices[i] = data.neighbors[i].second;
+    }
+
+    return n;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+kDTree::
+_scan_leaf(const Node& _node, RadiusNeighborData& _data) const
+{
+    const Scalar rx = _data.ref[0], ry = _data.ref[1], rz = _data.ref[2];
+    Scalar dist[leaf_block_];
+
+    for (unsigned int b=_node.begin_; b<_node.end_; b+=leaf_block_)
+    {
+        const unsigned int n = std::min(leaf_block_, _node.end_-b);
+
+        // squared distances of one block, vectorizes on SoA data
+        for (unsigned int i=0; i<n; ++i)
+        {
+            const Scalar dx = x_[b+i]-rx, dy = y_[b+i]-ry, dz = z_[b+i]-rz;
+            dist[i] = dx*dx + dy*dy + dz*dz;
+        }
+
+        for (unsigned int i=0; i<n; ++i)
+            if (dist[i] <= _data.dist)
+                _data.neighbors.emplace_back(dist[i], idx_[b+i]);
+    }
+}
+
+
 //=============================================================================
@@ -11,6 +11,7 @@
 
 #include <pmp/Types.h>
 #include <vector>
+#include <utility>
 
 using namespace pmp;
 
@@ -53,6 +54,48 @@ public:
     };
 
 
+    /// Functor for sorting elements along the splitting axis in decreasing
+    /// order, such that the left child gets the points above the plane
+    struct AxisGreater
+    {
+        AxisGreater(unsigned char _cut_dim) : cut_dim_(_cut_dim) {}
+
+        bool operator()(const Element& _a, const Element& _b) const { return _a.point[cut_dim_] > _b.point[cut_dim_]; }
+
+        unsigned char   cut_dim_;
+    };
+
+
+    /// How build() chooses the splitting plane of a node
+    enum SplitRule
+    {
+        /// center of the longest side of the points' bounding box
+        MidpointSplit,
+        /// median point along the longest side of the node's cell
+        MedianSplit
+    };
+
+
+    /// Statistics of the last build()
+    struct BuildStatistics
+    {
+        unsigned int   n_nodes;
+        unsigned int   n_leaves;
+
+        // minimum and maximum depth of all leaves
+        unsigned int   min_depth, max_depth;
+
+        // average depth of the leaves, weighted by their number of points
+        double         avg_depth;
+
+        // number of points in the largest leaf
+        unsigned int   max_leaf_size;
+
+        // build time in milliseconds
+        double         time;
+    };
+
+
     /// Store nearest neighbor information
     struct NearestNeighborData
     {
@@ -68,24 +111,60 @@ public:
     };
 
 
-    /// Node of the tree: contains parent, children and splitting plane
-    struct Node
+    /// Store k-nearest neighbor information
+    struct KNearestNeighborData
+    {
+        // Point for which we compute the nearest neighbors
+        Point          ref;
+
+        // number of neighbors to search for
+        unsigned int   k;
+
+        // (sqr-dist, index) of the neighbors found so far, as max-heap
+        std::vector< std::pair<Scalar,int> >  heap;
+
+        // squared distance to the k-th neighbor, or the squared search
+        // radius while the heap is not full (FLT_MAX if unbounded)
+        Scalar         dist;
+
+        unsigned int   leaf_tests;
+    };
+
+
+    /// Store information for radius queries
+    struct RadiusNeighborData
     {
-        Node(ElementIter _begin, ElementIter _end)
-            : left_child_(0), right_child_(0), begin_(_begin), end_(_end) {}
+        // Point for which we collect the neighbors
+        Point          ref;
+
+        // squared search radius
+        Scalar         dist;
+
+        // (sqr-dist, index) of all neighbors within the radius
+        std::vector< std::pair<Scalar,int> >  neighbors;
+
+        unsigned int   leaf_tests;
+    };
+
 
-        ~Node()
-        {
-            delete left_child_;
-            delete right_child_;
-        }
+    /** Node of the tree: contains children and splitting plane. Nodes are
+        stored contiguously in one array and refer to each other by index.
+        The two children of a node are stored next to each other, the left
+        child at `child_` and the right child at `child_+1`. Leaves have
+        `child_==0` and refer to the range `[begin_,end_)` of the leaf arrays. */
+    struct Node
+    {
+        Node(unsigned int _begin, unsigned int _end)
+            : begin_(_begin), end_(_end), child_(0), cut_dim_(0), cut_val_(0) {}
 
-        Node *left_child_, *right_child_;
-        ElementIter begin_, end_;
+        unsigned int   begin_, end_;
+        unsigned int   child_;
         unsigned char  cut_dim_;
-        Scalar cut_val_;
+        Scalar         cut_val_;
     };
 
+    typedef std::vector<Node>  Nodes;
+
 
 
 public:
@@ -94,36 +173,110 @@ public:
 
     /** Constructor: need traits that define the types and
         give us the points by traits_.point(PointHandle) */
-    kDTree(const Points& _points) : points_(_points), root_(0) {}
+    kDTree(const Points& _points) : points_(_points), stats_() {}
 
-    /// Destructor
-    ~kDTree() { delete root_; }
+    /** Build the tree. Returns number of nodes. Large subtrees are built
+        in parallel. With `MedianSplit` the tree is balanced and built in
+        O(n log n), which pays off for clustered point sets. */
+    unsigned int build(unsigned int _max_handles=100, unsigned int _max_depth=50,
+                       SplitRule _rule=MidpointSplit);
 
-    /// Build the tree. Returns number of nodes.
-    unsigned int build(unsigned int _max_handles=100, unsigned int _max_depth=50);
+    /// Return statistics (size, depth, timing) of the last build()
+    const BuildStatistics& statistics() const { return stats_; }
 
     /// Return handle of the nearest neighbor
     NearestNeighborData nearest(const Point& _p) const;
 
+    /** Find the `_k` nearest neighbors of `_p`. Their indices and distances
+        are stored in `_indices` and `_dists`, sorted by increasing distance.
+        Returns the number of neighbors found, which is less than `_k` only
+        if the tree contains less than `_k` points. */
+    unsigned int k_nearest(const Point& _p, unsigned int _k,
+                           std::vector<int>& _indices,
+                           std::vector<Scalar>& _dists) const;
+
+    /** Find the k nearest neighbors using caller-provided data, which avoids
+        allocations when answering many queries. Set `ref`, `k` and `dist`
+        before calling. `dist` is the squared search radius: use FLT_MAX, or
+        a known upper bound of the squared distance to the k-th neighbor to
+        prune the search (warm start). On return `heap` holds the
+        (sqr-dist, index) pairs sorted by increasing distance. */
+    void k_nearest(KNearestNeighborData& _data) const;
+
+    /** Find all points within distance `_r` of `_p`. Their indices and
+        distances are stored in `_indices` and `_dists`, sorted by increasing
+        distance. Returns the number of neighbors found. */
+    unsigned int radius(const Point& _p, Scalar _r,
+                        std::vector<int>& _indices,
+                        std::vector<Scalar>& _dists) const;
+
+    /** Batch version of k_nearest(): answer the queries `_queries` in parallel.
+        The results for query `i` are written to `_indices[i*_k ... i*_k+_k-1]`
+        and `_dists[i*_k ... i*_k+_k-1]`, so both arrays have to provide space
+        for `_queries.size()*_k` entries. `_dists` may be null. Unused slots
+        (less than `_k` points in the tree) get index -1 and distance FLT_MAX. */
+    void k_nearest(const Points& _queries, unsigned int _k,
+                   int* _indices, Scalar* _dists = nullptr) const;
+
 private:
 
     //----------------------------------------------------------- private methods
 
-    /// Recursive part of build()
-    void _build(Node*        _node,
-                unsigned int _max_handles,
-                unsigned int _depth);
+    /** Recursive part of build(): split node `_node` of `_nodes`, whose
+        cell is bounded by `_bb_min` and `_bb_max`. */
+    void _build(Nodes&        _nodes,
+                unsigned int  _node,
+                Point         _bb_min,
+                Point         _bb_max,
+                unsigned int  _max_handles,
+                unsigned int  _depth,
+                SplitRule     _rule);
+
+    /** Attach the separately built subtrees `_left` and `_right` as
+        children of node `_node` of `_nodes`. */
+    static void _splice(Nodes&        _nodes,
+                        unsigned int  _node,
+                        const Nodes&  _left,
+                        const Nodes&  _right);
+
+    /// Collect size and depth statistics of the tree
+    void _compute_statistics();
+
+    /** Iterative traversal shared by all queries, using an explicit stack.
+        Visits the leaves closer than `_data.dist` to `_data.ref` and
+        hands them to the matching _scan_leaf(). */
+    template <class Data>
+    void _search(Data& _data) const;
 
-    /// Recursive part of nearest()
-    void _nearest(Node* _node, NearestNeighborData& _data) const;
+    /// Leaf scan of nearest()
+    void _scan_leaf(const Node& _node, NearestNeighborData& _data) const;
+
+    /// Leaf scan of k_nearest()
+    void _scan_leaf(const Node& _node, KNearestNeighborData& _data) const;
+
+    /// Leaf scan of radius()
+    void _scan_leaf(const Node& _node, RadiusNeighborData& _data) const;
 
 
     //-------------------------------------------------------------- private data
 
+    /// maximum tree depth, bounds the size of the traversal stack
+    static constexpr unsigned int max_depth_ = 64;
+
+    /// number of points a leaf scan processes at once
+    static constexpr unsigned int leaf_block_ = 16;
+
+    /// subtrees with at least this many points are built as parallel tasks
+    static constexpr unsigned int parallel_threshold_ = 10000;
+
     const Points&  points_;
     Elements       elements_;
-    Node           *root_;
-    unsigned int   n_nodes_;
+    Nodes          nodes_;
+    BuildStatistics stats_;
+
+    // leaf points in tree order, as structure of arrays
+    std::vector<Scalar>  x_, y_, z_;
+    std::vector<int>     idx_;
 };
 
 //=============================================================================
@@ -9,6 +9,7 @@
 
 #include "reconstruction.h"
 #include "Grid.h"
+#include "SparseGrid.h"
 #include "MarchingCubes.h"
 #include "kDTree.h"
 #include <float.h>
@@ -17,10 +18,45 @@ using namespace pmp;
 
 //=============================================================================
 
+//! Signed distance of `x` to the tangent planes of its nearest samples.
+//! `data` has to contain the neighbors of the previous query (warm start)
+//! or nothing, and contains the neighbors of `x` on return.
+static Scalar signed_distance(const PointSet &pointset,
+                              const kDTree &kd,
+                              const Point &x,
+                              kDTree::KNearestNeighborData &data)
+{
+    // warm start: the neighbors of the previous node bound
+    // the distance to the k-th neighbor of this node
+    Scalar bound = FLT_MAX;
+    if (data.heap.size() == data.k) {
+        bound = 0;
+        for (auto& nb : data.heap) {
+            bound = std::max(bound, sqrnorm(x - pointset.points_[nb.second]));
+        }
+        bound *= 1.0001; // guard against rounding
+    }
+
+    data.ref  = x;
+    data.dist = bound;
+    kd.k_nearest(data);
+
+    // average signed distance to the tangent planes of the neighbors
+    Scalar dist = 0;
+    for (auto& nb : data.heap) {
+        dist += dot(x - pointset.points_[nb.second], pointset.normals_[nb.second]);
+    }
+    return dist / data.heap.size();
+}
+
+//=============================================================================
+
 void reconstruct_hoppe(const PointSet &pointset,
                        pmp::SurfaceMesh &mesh,
                        unsigned int resolution,
-                       unsigned int nneighbors)
+                       unsigned int nneighbors,
+                       ExecutionPolicy policy,
+                       unsigned int band)
 {
     // we need some points...
     if (pointset.points_.empty())
@@ -45,6 +81,78 @@ void reconstruct_hoppe(const PointSet &pointset,
     int res_z = std::max(2, (int)(bb_diag[2] / grid_spacing));
 
 
+    // build kD-tree for closest point queries
+    auto kd = kDTree(pointset.points_);
+    kd.build(100, 50, kDTree::MedianSplit);
+
+    const unsigned int n_neighbors = std::max(1u, nneighbors);
+
+
+    // narrow band: evaluate SDF only in bricks close to the points
+    if (band > 0)
+    {
+        SparseGrid grid(bb_min,
+                        Point(bb_max[0] - bb_min[0], 0, 0),
+                        Point(0, bb_max[1] - bb_min[1], 0),
+                        Point(0, 0, bb_max[2] - bb_min[2]),
+                        res_x, res_y, res_z);
+
+        // allocate all bricks within `band` bricks of a point's brick
+        const int B = SparseGrid::brick_size;
+        const int n_bricks[3] = { (res_x + B - 1) / B, (res_y + B - 1) / B, (res_z + B - 1) / B };
+        const Point scale((res_x - 1) / (bb_max[0] - bb_min[0]),
+                          (res_y - 1) / (bb_max[1] - bb_min[1]),
+                          (res_z - 1) / (bb_max[2] - bb_min[2]));
+        ivec3 last(-1, -1, -1);
+        for (const auto& p : pointset.points_) {
+            ivec3 b;
+            for (int d = 0; d < 3; d++) {
+                b[d] = std::min((int)((p[d] - bb_min[d]) * scale[d]) / B, n_bricks[d] - 1);
+            }
+            if (b == last) continue;
+            last = b;
+
+            for (int i = std::max(0, b[0] - (int)band); i <= std::min(n_bricks[0] - 1, b[0] + (int)band); i++) {
+                for (int j = std::max(0, b[1] - (int)band); j <= std::min(n_bricks[1] - 1, b[1] + (int)band); j++) {
+                    for (int k = std::max(0, b[2] - (int)band); k <= std::min(n_bricks[2] - 1, b[2] + (int)band); k++) {
+                        grid.allocate_brick(i, j, k);
+                    }
+                }
+            }
+        }
+
+        // evaluate all allocated bricks, rows along z use warm starts
+#pragma omp parallel if (policy == ExecutionPolicy::Parallel)
+        {
+            kDTree::KNearestNeighborData data;
+            data.k = n_neighbors;
+            data.heap.reserve(n_neighbors);
+
+#pragma omp for schedule(dynamic, 1)
+            for (int b = 0; b < (int)grid.n_bricks(); b++) {
+                const ivec3& bc = grid.brick_coordinates(b);
+                float* values = grid.brick_values(b);
+                const int i1 = std::min((bc[0] + 1) * B, res_x);
+                const int j1 = std::min((bc[1] + 1) * B, res_y);
+                const int k1 = std::min((bc[2] + 1) * B, res_z);
+
+                for (int i = bc[0] * B; i < i1; i++) {
+                    for (int j = bc[1] * B; j < j1; j++) {
+                        data.heap.clear();
+                        for (int k = bc[2] * B; k < k1; k++) {
+                            values[SparseGrid::local_index(i,j,k)] =
+                                signed_distance(pointset, kd, grid.point(i,j,k), data);
+                        }
+                    }
+                }
+            }
+        }
+
+        marching_cubes(grid, mesh, 0, policy == ExecutionPolicy::Parallel);
+        return;
+    }
+
+
     // setup grid for storing distance values
     Grid grid(bb_min,
               Point(bb_max[0] - bb_min[0], 0, 0),
@@ -61,20 +169,37 @@ void reconstruct_hoppe(const PointSet &pointset,
      * - Extract mesh with `marching_cubes(grid, mesh)`
      */
 
-    auto kd = kDTree(pointset.points_);
-    kd.build();
-
-    for (int i = 0; i < res_x; i++) {
-        for (int j = 0; j < res_y; j++) {
-            for (int k = 0; k < res_z; k++) {
-                auto nearestIndex = kd.nearest(grid.point(i,j,k)).nearest;
-                auto x_minus_c = grid.point(i,j,k) - pointset.points_[nearestIndex];
-                grid(i,j,k) = dot(x_minus_c, pointset.normals_[nearestIndex]);
+    // grid nodes are processed in tiles of tile x tile rows along z,
+    // such that each thread works on a spatially coherent block
+    const int tile = 8;
+    const int n_tiles_x = (res_x + tile - 1) / tile;
+    const int n_tiles_y = (res_y + tile - 1) / tile;
+    const int n_tiles = n_tiles_x * n_tiles_y;
+
+#pragma omp parallel if (policy == ExecutionPolicy::Parallel)
+    {
+        // neighbor search data, re-used by all queries of this thread
+        kDTree::KNearestNeighborData data;
+        data.k = n_neighbors;
+        data.heap.reserve(n_neighbors);
+
+#pragma omp for schedule(dynamic, 1)
+        for (int t = 0; t < n_tiles; t++) {
+            const int i0 = (t / n_tiles_y) * tile, i1 = std::min(i0 + tile, res_x);
+            const int j0 = (t % n_tiles_y) * tile, j1 = std::min(j0 + tile, res_y);
+
+            for (int i = i0; i < i1; i++) {
+                for (int j = j0; j < j1; j++) {
+                    data.heap.clear();
+                    for (int k = 0; k < res_z; k++) {
+                        grid(i,j,k) = signed_distance(pointset, kd, grid.point(i,j,k), data);
+                    }
+                }
             }
         }
     }
 
-    marching_cubes(grid, mesh);
+    marching_cubes(grid, mesh, 0, policy == ExecutionPolicy::Parallel);
 }
 
 //=============================================================================
@@ -9,73 +9,446 @@
 
 #include "reconstruction.h"
 #include <poisson/poisson.h>
+#include <pmp/MemoryUsage.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <unordered_map>
 
 using namespace pmp;
 
 //=============================================================================
 
-void reconstruct_poisson(const PointSet &pointset,
-                         SurfaceMesh &mesh,
-                         int depth,
-                         int solver_divide,
-                         float point_weight)
+// Receives the iso-surface of Poisson's marching cubes and builds a
+// SurfaceMesh from it. The extractor adds out-of-core vertices and polygons
+// from several threads under two different locks, so both are only
+// collected in flat arrays here; build() then writes all vertices and
+// triangles into the reserved mesh without any per-face allocation.
+// Vertices are ordered as by CoredPoissonVectorMeshData: the in-core
+// vertices first, followed by the out-of-core ones.
+class Poisson_mesh_sink : public CoredMeshData<PlyVertex<float>>
 {
-    // store points and normals in two arrays
-    const unsigned int N = pointset.points_.size();
-    std::vector<Point3D<float>> points(N), normals(N);
-    for (unsigned int i = 0; i < N; i++)
+public:
+
+    void resetIterator() override
     {
-        points[i].coords[0] = pointset.points_[i][0];
-        points[i].coords[1] = pointset.points_[i][1];
-        points[i].coords[2] = pointset.points_[i][2];
-        normals[i].coords[0] = pointset.normals_[i][0];
-        normals[i].coords[1] = pointset.normals_[i][1];
-        normals[i].coords[2] = pointset.normals_[i][2];
+        point_index_ = triangle_index_ = 0;
     }
 
-    // perform Poisson reconstruction
-    CoredPoissonVectorMeshData<PlyVertex<float>> reconstructed_mesh;
-    Execute2(points, normals, reconstructed_mesh, depth, solver_divide,
-             point_weight);
+    int addOutOfCorePoint(const PlyVertex<float>& _p) override
+    {
+        points_.emplace_back(_p.point[0], _p.point[1], _p.point[2]);
+        return int(points_.size()) - 1;
+    }
 
-    // initialize
-    mesh.clear();
-    reconstructed_mesh.resetIterator();
+    int addPolygon(const std::vector<CoredVertexIndex>& _vertices) override
+    {
+        // GetMCIsoTriangles() only emits triangles if polygonMesh is false,
+        // as in Execute(), everything else is triangulated as a fan
+        for (size_t i = 2; i < _vertices.size(); ++i)
+        {
+            triangles_.push_back(encode(_vertices[0]));
+            triangles_.push_back(encode(_vertices[i - 1]));
+            triangles_.push_back(encode(_vertices[i]));
+        }
+        return polygonCount() - 1;
+    }
+
+    int nextOutOfCorePoint(PlyVertex<float>& _p) override
+    {
+        if (point_index_ >= points_.size())
+            return 0;
+        const Point& p = points_[point_index_++];
+        _p.point = Point3D<float>(p[0], p[1], p[2]);
+        return 1;
+    }
 
-    // add vertices to mesh
-    PlyVertex<float> p;
-    for (int i(0); i < (int)reconstructed_mesh.inCorePoints.size(); i++)
+    int nextPolygon(std::vector<CoredVertexIndex>& _vertices) override
     {
-        p = reconstructed_mesh.inCorePoints[i];
-        mesh.add_vertex(
-            vec3(p.point.coords[0], p.point.coords[1], p.point.coords[2]));
+        if (triangle_index_ >= triangles_.size())
+            return 0;
+        _vertices.resize(3);
+        for (int j = 0; j < 3; ++j)
+        {
+            const int idx = triangles_[triangle_index_++];
+            _vertices[j].inCore = (idx >= 0);
+            _vertices[j].idx = idx >= 0 ? idx : -idx - 1;
+        }
+        return 1;
     }
-    for (int i(0); i < reconstructed_mesh.outOfCorePointCount(); i++)
+
+    int outOfCorePointCount() override { return int(points_.size()); }
+
+    int polygonCount() override { return int(triangles_.size() / 3); }
+
+    /// replace the contents of \c _mesh by the collected iso-surface
+    void build(SurfaceMesh& _mesh) const
     {
-        reconstructed_mesh.nextOutOfCorePoint(p);
-        mesh.add_vertex(
-            vec3(p.point.coords[0], p.point.coords[1], p.point.coords[2]));
+        const size_t n_in_core = inCorePoints.size();
+        const size_t n_vertices = n_in_core + points_.size();
+        const size_t n_faces = triangles_.size() / 3;
+
+        _mesh.clear();
+        _mesh.reserve(n_vertices, 3 * n_faces / 2, n_faces);
+
+        for (const PlyVertex<float>& p : inCorePoints)
+            _mesh.add_vertex(Point(p.point[0], p.point[1], p.point[2]));
+        for (const Point& p : points_)
+            _mesh.add_vertex(p);
+
+        auto vertex = [n_in_core](int idx) {
+            return Vertex(idx >= 0 ? idx : int(n_in_core) - idx - 1);
+        };
+        for (size_t i = 0; i < triangles_.size(); i += 3)
+            _mesh.add_triangle(vertex(triangles_[i]),
+                               vertex(triangles_[i + 1]),
+                               vertex(triangles_[i + 2]));
     }
 
-    // add faces to mesh
-    std::vector<CoredVertexIndex> polygon;
-    std::vector<Vertex> vertices;
-    for (int i(0); i < reconstructed_mesh.polygonCount(); i++)
+private:
+
+    // in-core vertex i is stored as i, out-of-core vertex i as -i-1
+    static int encode(const CoredVertexIndex& _v)
     {
-        reconstructed_mesh.nextPolygon(polygon);
-        vertices.resize(polygon.size());
+        return _v.inCore ? _v.idx : -_v.idx - 1;
+    }
+
+    std::vector<Point> points_;
+    std::vector<int>   triangles_;
+    size_t point_index_ = 0;
+    size_t triangle_index_ = 0;
+};
+
+//=============================================================================
 
-        for (unsigned int j = 0; j < polygon.size(); ++j)
+// parameters of Execute() that determine the octree
+static const int   poisson_min_depth        = 5;
+static const int   poisson_kernel_offset    = 2;    // kernel depth = depth - 2
+static const float poisson_scale            = 1.1f;
+static const float poisson_samples_per_node = 1.0f;
+
+// bytes per octree node while the tree is built, and additionally per node
+// while the system is assembled and solved; below the solver's subdivision
+// depth only one block of nodes is solved at a time (calibrated by the
+// peak RSS of reconstructions of bunny.pts and a 400k point torus)
+static const size_t poisson_node_bytes         = 64;
+static const size_t poisson_solver_bytes       = 270;
+static const size_t poisson_block_solver_bytes = 40;
+
+//-----------------------------------------------------------------------------
+
+// spread the lower 21 bits of v to every third bit
+static uint64_t spread_bits(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v <<  8) & 0x100f00f00f00f00full;
+    v = (v | v <<  4) & 0x10c30c30c30c30c3ull;
+    v = (v | v <<  2) & 0x1249249249249249ull;
+    return v;
+}
+
+// inverse of spread_bits()
+static uint32_t compact_bits(uint64_t v)
+{
+    v &= 0x1249249249249249ull;
+    v = (v ^ (v >>  2)) & 0x10c30c30c30c30c3ull;
+    v = (v ^ (v >>  4)) & 0x100f00f00f00f00full;
+    v = (v ^ (v >>  8)) & 0x1f0000ff0000ffull;
+    v = (v ^ (v >> 16)) & 0x1f00000000ffffull;
+    v = (v ^ (v >> 32)) & 0x1fffffull;
+    return uint32_t(v);
+}
+
+// Morton code of an octree cell: the code of its parent is code >> 3
+static uint64_t morton(uint32_t x, uint32_t y, uint32_t z)
+{
+    return spread_bits(x) | spread_bits(y) << 1 | spread_bits(z) << 2;
+}
+
+//-----------------------------------------------------------------------------
+
+// Poisson's sample density at the cells of one level, given as sorted Morton
+// codes with the number of samples in each. Octree::setTree() splats every
+// sample into the 3x3x3 nodes around it with the quadratic B-spline and
+// evaluates the splatted weights with the B-spline again, so a sample
+// contributes to the density of the cells in its 5x5x5 neighborhood with
+// the spline's autocorrelation (averaged over positions within the cell).
+static void sample_density(const std::vector<uint64_t> &cells,
+                           const std::vector<uint32_t> &counts,
+                           std::vector<float> &density)
+{
+    static const float w[5] = {0.037f, 0.260f, 0.519f, 0.260f, 0.037f};
+
+    std::unordered_map<uint64_t, uint32_t> index(2 * cells.size());
+    for (size_t i = 0; i < cells.size(); ++i)
+        index[cells[i]] = uint32_t(i);
+
+    density.resize(cells.size());
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (long long i = 0; i < (long long)cells.size(); ++i)
+    {
+        const int x = compact_bits(cells[i]);
+        const int y = compact_bits(cells[i] >> 1);
+        const int z = compact_bits(cells[i] >> 2);
+        float sum = 0.0f;
+        for (int a = 0; a < 5; ++a)
+            for (int b = 0; b < 5; ++b)
+                for (int c = 0; c < 5; ++c)
+                {
+                    if (x + a < 2 || y + b < 2 || z + c < 2) continue;
+                    auto it = index.find(morton(x + a - 2, y + b - 2, z + c - 2));
+                    if (it != index.end())
+                        sum += counts[it->second] * w[a] * w[b] * w[c];
+                }
+        density[i] = sum;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+PoissonEstimate estimate_poisson(const std::vector<Point> &points,
+                                 int depth,
+                                 int solver_divide)
+{
+    const int max_depth    = std::min(std::max(depth, poisson_min_depth), 21);
+    const int kernel_depth = std::max(max_depth - poisson_kernel_offset, 0);
+
+    // the octree is complete down to the minimum depth
+    PoissonEstimate estimate;
+    estimate.nodes = 0;
+    for (int d = 0; d <= poisson_min_depth; ++d)
+        estimate.nodes += size_t(1) << (3 * d);
+    size_t built_nodes = estimate.nodes, block_nodes = 0;
+
+    const size_t n = points.size();
+    if (n)
+    {
+        // the points' bounding cube, scaled as in Octree::setTree()
+        BoundingBox bb;
+        for (const Point &p : points)
+            bb += p;
+        const Point diag = bb.max() - bb.min();
+        Scalar extent = poisson_scale * std::max(diag[0], std::max(diag[1], diag[2]));
+        if (extent <= 0) extent = 1;
+        const Point origin = bb.center() - Point(0.5f * extent);
+
+        // Morton codes of the points' cells at the maximum depth
+        const Scalar scale = Scalar(1u << max_depth) / extent;
+        const int last = int(1u << max_depth) - 1;
+        std::vector<uint64_t> codes(n);
+#pragma omp parallel for schedule(static)
+        for (long long i = 0; i < (long long)n; ++i)
+        {
+            const Point q = (points[i] - origin) * scale;
+            codes[i] = morton(std::min(std::max(int(q[0]), 0), last),
+                              std::min(std::max(int(q[1]), 0), last),
+                              std::min(std::max(int(q[2]), 0), last));
+        }
+        std::sort(codes.begin(), codes.end());
+
+        // Points are splatted at the (fractional) depth where the density
+        // is samples_per_node. It is taken from the kernel depth, where the
+        // density grows by the ratio to the parent level per level.
+        std::vector<uint64_t> cells[2];
+        std::vector<uint32_t> counts[2];
+        std::vector<float>    density[2];
+        for (int l = 0; l < 2; ++l)
+        {
+            const int shift = 3 * (max_depth - kernel_depth + l);
+            for (size_t i = 0; i < n; ++i)
+            {
+                const uint64_t c = codes[i] >> shift;
+                if (cells[l].empty() || cells[l].back() != c)
+                {
+                    cells[l].push_back(c);
+                    counts[l].push_back(0);
+                }
+                ++counts[l].back();
+            }
+            sample_density(cells[l], counts[l], density[l]);
+        }
+
+        std::vector<unsigned char> splat_depth(n);
+        const int kernel_shift = 3 * (max_depth - kernel_depth);
+        for (size_t i = 0, j = 0, c = 0, p = 0; i < n; i = j, ++c)
         {
-            if (polygon[j].inCore)
-                vertices[j] = Vertex(polygon[j].idx);
+            const uint64_t code = codes[i] >> kernel_shift;
+            for (j = i + 1; j < n && (codes[j] >> kernel_shift) == code; ++j) {}
+            while (cells[1][p] != code >> 3) ++p;
+
+            const double w = density[0][c], w_parent = density[1][p];
+            double d;
+            if (w >= poisson_samples_per_node)
+                d = kernel_depth + std::log(w / poisson_samples_per_node) / std::log(4.0);
+            else if (w_parent >= poisson_samples_per_node && w_parent > w)
+                d = kernel_depth - 1 + std::log(w_parent / poisson_samples_per_node) / std::log(w_parent / w);
             else
-                vertices[j] =
-                    Vertex(polygon[j].idx +
-                           int(reconstructed_mesh.inCorePoints.size()));
+                d = kernel_depth - 1 + std::log(w_parent / poisson_samples_per_node) / std::log(4.0);
+            const int top = std::min(std::max(int(std::ceil(d)), poisson_min_depth), max_depth);
+            std::fill(splat_depth.begin() + i, splat_depth.begin() + j, (unsigned char)top);
+        }
+
+        // Nodes of a level: splatting into a node creates its 3x3x3
+        // neighborhood, i.e., all children of its parent's neighbors. Above
+        // the kernel depth this happens for all points during density
+        // estimation, ClipTree() later removes nodes away from the surface.
+        std::vector<uint64_t> parents, neighbors;
+        auto level_nodes = [&](int d, bool all_points) {
+            const int shift = 3 * (max_depth - d + 1);
+            parents.clear();
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (!all_points && splat_depth[i] < d) continue;
+                const uint64_t c = codes[i] >> shift;
+                if (parents.empty() || parents.back() != c)
+                    parents.push_back(c);
+            }
+
+            const int res = 1 << (d - 1);
+            neighbors.clear();
+            for (uint64_t c : parents)
+            {
+                const int x = compact_bits(c), y = compact_bits(c >> 1), z = compact_bits(c >> 2);
+                for (int i = std::max(x - 1, 0); i <= std::min(x + 1, res - 1); ++i)
+                    for (int j = std::max(y - 1, 0); j <= std::min(y + 1, res - 1); ++j)
+                        for (int k = std::max(z - 1, 0); k <= std::min(z + 1, res - 1); ++k)
+                            neighbors.push_back(morton(i, j, k));
+            }
+            std::sort(neighbors.begin(), neighbors.end());
+            return 8 * size_t(std::unique(neighbors.begin(), neighbors.end()) - neighbors.begin());
+        };
+
+        for (int d = poisson_min_depth + 1; d <= max_depth; ++d)
+        {
+            const size_t nodes = level_nodes(d, false);
+            estimate.nodes += nodes;
+            if (d > solver_divide) block_nodes += nodes;
+            built_nodes += (d <= kernel_depth) ? level_nodes(d, true) : nodes;
+        }
+    }
+
+    estimate.memory = built_nodes * poisson_node_bytes +
+                      (estimate.nodes - block_nodes) * poisson_solver_bytes +
+                      block_nodes * poisson_block_solver_bytes +
+                      n * (sizeof(Point3D<float>) + sizeof(int));
+    return estimate;
+}
+
+//-----------------------------------------------------------------------------
+
+int poisson_depth_for_budget(const std::vector<Point> &points,
+                             size_t memory_budget,
+                             int max_depth,
+                             int solver_divide,
+                             PoissonEstimate *estimate)
+{
+    for (int depth = max_depth; depth >= poisson_min_depth; --depth)
+    {
+        const PoissonEstimate e = estimate_poisson(points, depth, solver_divide);
+        if (e.memory <= memory_budget)
+        {
+            if (estimate)
+                *estimate = e;
+            return depth;
+        }
+    }
+    return 0;
+}
+
+//=============================================================================
+
+bool reconstruct_poisson(const PointSet &pointset,
+                         SurfaceMesh &mesh,
+                         int depth,
+                         int solver_divide,
+                         float point_weight,
+                         int threads,
+                         size_t memory_budget,
+                         bool report)
+{
+    return reconstruct_poisson(pointset.points_, pointset.normals_, mesh,
+                               depth, solver_divide, point_weight, threads,
+                               memory_budget, report);
+}
+
+//-----------------------------------------------------------------------------
+
+bool reconstruct_poisson(const std::vector<Point> &points,
+                         const std::vector<Normal> &normals,
+                         SurfaceMesh &mesh,
+                         int depth,
+                         int solver_divide,
+                         float point_weight,
+                         int threads,
+                         size_t memory_budget,
+                         bool report)
+{
+    static_assert(sizeof(Point) == 3 * sizeof(float) &&
+                      sizeof(Normal) == 3 * sizeof(float),
+                  "points and normals must be packed float triples");
+
+    // highest depth (up to the requested one) that fits the budget
+    PoissonEstimate estimate = {0, 0};
+    if (memory_budget)
+    {
+        const int d = poisson_depth_for_budget(points, memory_budget, depth,
+                                               solver_divide, &estimate);
+        if (!d)
+        {
+            std::cerr << "Poisson: " << memory_budget / (1024 * 1024)
+                      << " MB are not enough for octree depth "
+                      << poisson_min_depth << std::endl;
+            return false;
         }
-        mesh.add_face(vertices);
+        if (d < depth)
+            std::cout << "Poisson: octree depth " << depth
+                      << " exceeds the memory budget, using depth " << d
+                      << std::endl;
+        depth = d;
+    }
+
+    // Poisson reads points and normals in place
+    const Point3DView<float> pts(points.empty() ? nullptr : points[0].data(),
+                                 points.size());
+    const Point3DView<float> nrm(normals.empty() ? nullptr : normals[0].data(),
+                                 normals.size());
+
+    // on request, compare the estimate to the peak RSS after each phase (the
+    // peak is process-wide, i.e., it only grows if the phase needed more
+    // memory than anything before)
+    std::function<void(const char *)> phase_done;
+    if (report)
+    {
+        if (!memory_budget)
+            estimate = estimate_poisson(points, depth, solver_divide);
+        std::cout << "Poisson depth " << depth << ": estimated "
+                  << estimate.nodes << " nodes, "
+                  << estimate.memory / (1024 * 1024) << " MB" << std::endl;
+
+        phase_done = [](const char *phase) {
+            std::cout << "  " << phase << ": peak RSS "
+                      << MemoryUsage::max_size() / (1024 * 1024)
+                      << " MB, current "
+                      << MemoryUsage::current_size() / (1024 * 1024) << " MB"
+                      << std::endl;
+        };
+        phase_done("input");
     }
+
+    // perform Poisson reconstruction, the sink collects the iso-surface
+    Poisson_mesh_sink sink;
+    Execute2(pts, nrm, sink, depth, solver_divide, point_weight, 1.0f, 1.0f,
+             threads, phase_done);
+
+    sink.build(mesh);
+    if (phase_done)
+        phase_done("mesh");
+
+    return true;
 }
 
 //=============================================================================
@@ -14,17 +14,71 @@
 
 //=============================================================================
 
-//! reconstruct mesh using Poisson surface reconstruction
-void reconstruct_poisson(const PointSet &pointset,
+//! reconstruct mesh using Poisson surface reconstruction. `threads` is the
+//! number of OpenMP threads for octree setup, solver and iso-surface
+//! extraction, 0 uses all available threads. If `memory_budget` (in bytes)
+//! is non-zero, the octree depth is reduced until the memory estimated by
+//! estimate_poisson() fits; returns false (and leaves `mesh` untouched) if
+//! no depth fits. With `report`, the estimate and the peak memory after each
+//! phase are printed.
+bool reconstruct_poisson(const PointSet &pointset,
                          pmp::SurfaceMesh &mesh,
                          int depth,
                          int solver_divide,
-                         float point_weight);
+                         float point_weight,
+                         int threads = 0,
+                         size_t memory_budget = 0,
+                         bool report = false);
 
-//! reconstruct mesh using Hoppe's approach
+//! Poisson reconstruction from point and normal arrays, e.g., from
+//! read_point_cloud(), which needs no PointSet (and no OpenGL context)
+bool reconstruct_poisson(const std::vector<pmp::Point> &points,
+                         const std::vector<pmp::Normal> &normals,
+                         pmp::SurfaceMesh &mesh,
+                         int depth,
+                         int solver_divide,
+                         float point_weight,
+                         int threads = 0,
+                         size_t memory_budget = 0,
+                         bool report = false);
+
+//! predicted size of a Poisson reconstruction
+struct PoissonEstimate
+{
+    size_t nodes;   //!< octree nodes after clipping
+    size_t memory;  //!< peak memory of the reconstruction itself in bytes
+};
+
+//! predict octree nodes and peak memory of reconstruct_poisson() at `depth`
+//! from the distribution of the points, without building the octree
+PoissonEstimate estimate_poisson(const std::vector<pmp::Point> &points,
+                                 int depth,
+                                 int solver_divide = 8);
+
+//! highest octree depth up to `max_depth` whose estimated memory fits into
+//! `memory_budget` bytes, 0 if not even the minimum depth fits. The
+//! estimate of the returned depth is stored in `estimate`, if given.
+int poisson_depth_for_budget(const std::vector<pmp::Point> &points,
+                             size_t memory_budget,
+                             int max_depth,
+                             int solver_divide = 8,
+                             PoissonEstimate *estimate = nullptr);
+
+//! how reconstruct_hoppe() evaluates the distance function on the grid
+enum class ExecutionPolicy
+{
+    Serial,   //!< all grid nodes on the calling thread
+    Parallel  //!< tiles of grid nodes distributed over all threads
+};
+
+//! reconstruct mesh using Hoppe's approach. If `band` is non-zero, the
+//! distance function is only evaluated on a sparse grid of bricks within
+//! `band` bricks (of 8^3 grid nodes) around the points.
 void reconstruct_hoppe(const PointSet &pointset,
                        pmp::SurfaceMesh &mesh,
                        unsigned int resolution,
-                       unsigned int nneighbors = 1);
+                       unsigned int nneighbors = 1,
+                       ExecutionPolicy policy = ExecutionPolicy::Parallel,
+                       unsigned int band = 0);
 
 //=============================================================================
@@ -10,71 +10,135 @@
 //=============================================================================
 
 #include "pmp/Types.h"
+#include <cstddef>
 using namespace pmp;
 
 //=============================================================================
 
-//! Simple class for implementing error quadrics
-class Quadric
+//! Simple class for implementing error quadrics, templated on the precision
+//! of its coefficients. The upper triangle of the symmetric 4x4 matrix is
+//! stored packed in one array, such that accumulation is a single loop the
+//! compiler vectorizes.
+template <typename Real>
+class QuadricT
 {
 public:
 
     //! constructor quadric from given plane equation: ax+by+cz+d=0
-    Quadric(Scalar a=0.0, Scalar b=0.0, Scalar c=0.0, Scalar d=0.0)
-        :  a_(a*a), b_(a*b), c_(a*c), d_(a*d),
-                    e_(b*b), f_(b*c), g_(b*d),
-                             h_(c*c), i_(c*d),
-                                      j_(d*d)
+    QuadricT(Real a=0.0, Real b=0.0, Real c=0.0, Real d=0.0)
+        : q_{ a*a, a*b, a*c, a*d,
+                   b*b, b*c, b*d,
+                        c*c, c*d,
+                             d*d }
     {}
 
     //! construct from point and normal specifying a plane
-    Quadric(const Normal& n, const Point& p)
+    QuadricT(const Normal& n, const Point& p)
     {
-        *this = Quadric(n[0], n[1], n[2], -dot(n,p));
+        const Real a(n[0]), b(n[1]), c(n[2]);
+        *this = QuadricT(a, b, c, -(a*p[0] + b*p[1] + c*p[2]));
     }
 
     //! add given quadric to this quadric: this += q
-    Quadric& operator+=(const Quadric& q)
+    QuadricT& operator+=(const QuadricT& q)
     {
-        a_ += q.a_; b_ += q.b_; c_ += q.c_; d_ += q.d_;
-                    e_ += q.e_; f_ += q.f_; g_ += q.g_;
-                                h_ += q.h_; i_ += q.i_;
-                                            j_ += q.j_;
+        for (int i = 0; i < 10; ++i)
+            q_[i] += q.q_[i];
         return *this;
     }
 
     //! add two quadrics: q1 + q2
-    friend Quadric operator+(Quadric q1, const Quadric& q2)
+    friend QuadricT operator+(QuadricT q1, const QuadricT& q2)
     {
         q1 += q2;
         return q1;
     }
 
     //! evaluate quadric Q at position p by computing (p^T * Q * p)
-    Scalar operator()(const Point& p) const
+    Real operator()(const Point& p) const
     {
-        const Scalar x(p[0]), y(p[1]), z(p[2]);
-        return a_*x*x + 2.0*b_*x*y + 2.0*c_*x*z + 2.0*d_*x
-            +  e_*y*y + 2.0*f_*y*z + 2.0*g_*y
-            +  h_*z*z + 2.0*i_*z
-            +  j_;
+        const Real x(p[0]), y(p[1]), z(p[2]);
+        return q_[0]*x*x + 2*q_[1]*x*y + 2*q_[2]*x*z + 2*q_[3]*x
+            +  q_[4]*y*y + 2*q_[5]*y*z + 2*q_[6]*y
+            +  q_[7]*z*z + 2*q_[8]*z
+            +  q_[9];
     }
 
-    //! (try to) find point that minimizes quadric error
-    Point minimizer() const
+    //! evaluate the quadric at the `n` positions `p` and store the results in
+    //! `errors`. The iterations are independent and vectorize over positions.
+    void evaluate(const Point* p, size_t n, Real* errors) const
     {
-        mat3 A{a_, b_, c_, b_, e_, f_, c_, f_, h_};
-        vec3 b{d_, g_, i_};
-        return -(inverse(A) * b);
+        for (size_t i = 0; i < n; ++i)
+            errors[i] = (*this)(p[i]);
+    }
+
+    //! find the point x that minimizes the quadric error by solving the 3x3
+    //! system in closed form (adjugate over determinant). Returns false and
+    //! leaves x untouched if the system is close to singular.
+    bool solve(Point& x) const
+    {
+        const Real a = q_[0], b = q_[1], c = q_[2],
+                              e = q_[4], f = q_[5],
+                                         h = q_[7];
+
+        // cofactors of the symmetric matrix, i.e. its adjugate
+        const Real c00 = e*h - f*f, c01 = c*f - b*h, c02 = b*f - c*e;
+        const Real c11 = a*h - c*c, c12 = b*c - a*f;
+        const Real c22 = a*e - b*b;
+
+        // the matrix is positive semi-definite, relate its determinant to
+        // the cubed trace to get a scale-invariant singularity test, which
+        // also rejects NaNs
+        const Real det   = a*c00 + b*c01 + c*c02;
+        const Real trace = a + e + h;
+        if (!(det > singular_threshold() * trace*trace*trace))
+            return false;
+
+        const Real r0 = -q_[3], r1 = -q_[6], r2 = -q_[8];
+        const Real s  = Real(1) / det;
+        x = Point((c00*r0 + c01*r1 + c02*r2) * s,
+                  (c01*r0 + c11*r1 + c12*r2) * s,
+                  (c02*r0 + c12*r1 + c22*r2) * s);
+        return true;
+    }
+
+    //! find the point that minimizes the quadric error. If the system is
+    //! singular, return the best of the edge endpoints p0, p1 and their
+    //! midpoint instead. Never throws.
+    Point minimizer(const Point& p0, const Point& p1) const
+    {
+        Point x;
+        if (solve(x))
+            return x;
+
+        const Point candidates[3] = { p0, p1, 0.5f * (p0 + p1) };
+        Real errors[3];
+        evaluate(candidates, 3, errors);
+
+        int best = 0;
+        for (int i = 1; i < 3; ++i)
+            if (errors[i] < errors[best])
+                best = i;
+        return candidates[best];
     }
 
 private:
 
-    Scalar a_, b_, c_, d_,
-               e_, f_, g_,
-                   h_, i_,
-                       j_;
+    //! relative determinant below which solve() gives up, coarser for float
+    static constexpr Real singular_threshold()
+    {
+        return sizeof(Real) < sizeof(double) ? Real(1e-5) : Real(1e-8);
+    }
+
+    //! upper triangle of the symmetric 4x4 matrix, row by row
+    Real q_[10];
 };
 
 
+//! quadric used by the Decimater, in double precision: float sums lose the
+//! small eigenvalues that decide the optimum; see CompactDecimater for a
+//! float variant
+using Quadric = QuadricT<double>;
+
+
 //============================================================================
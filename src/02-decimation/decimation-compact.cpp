@@ -0,0 +1,400 @@
+//=============================================================================
+//
+//   Exercise code for the lecture "Geometric Modeling"
+//   by Prof. Dr. Mario Botsch, TU Dortmund
+//
+//   Copyright (C) 2023 Computer Graphics Group, TU Dortmund.
+//
+//=============================================================================
+
+#include "decimation.h"
+#include <pmp/BoundingBox.h>
+#include <Eigen/Dense>
+#include <float.h>
+#include <algorithm>
+#include <cmath>
+using namespace pmp;
+
+//=============================================================================
+
+// largest dimension of quadric space: position, texture coordinate, color
+static const int max_dim = 8;
+
+// largest number of coefficients of a quadric
+static const int max_stride = (max_dim + 1) * (max_dim + 2) / 2;
+
+//-----------------------------------------------------------------------------
+
+// Add the generalized error quadric (Garland & Heckbert 1998) of the triangle
+// x0, x1, x2 in n dimensions to `q`. The upper triangle of the symmetric
+// matrix [A b; b^T c] is stored row by row, with A = I - e1 e1^T - e2 e2^T,
+// b = (p.e1) e1 + (p.e2) e2 - p and c = p.p - (p.e1)^2 - (p.e2)^2, where
+// p = x0 and e1, e2 is an orthonormal basis of the triangle's plane.
+static void add_face_quadric(int n, const double* x0, const double* x1,
+                             const double* x2, double* q)
+{
+    double e1[max_dim], e2[max_dim];
+
+    double l1 = 0.0;
+    for (int i = 0; i < n; ++i)
+    {
+        e1[i] = x1[i] - x0[i];
+        l1 += e1[i] * e1[i];
+    }
+    if (l1 < DBL_MIN)
+        return;
+    l1 = 1.0 / std::sqrt(l1);
+    for (int i = 0; i < n; ++i)
+        e1[i] *= l1;
+
+    double d = 0.0;
+    for (int i = 0; i < n; ++i)
+        d += (x2[i] - x0[i]) * e1[i];
+
+    double l2 = 0.0;
+    for (int i = 0; i < n; ++i)
+    {
+        e2[i] = x2[i] - x0[i] - d * e1[i];
+        l2 += e2[i] * e2[i];
+    }
+    if (l2 < DBL_MIN)
+        return;
+    l2 = 1.0 / std::sqrt(l2);
+    for (int i = 0; i < n; ++i)
+        e2[i] *= l2;
+
+    double pe1 = 0.0, pe2 = 0.0, pp = 0.0;
+    for (int i = 0; i < n; ++i)
+    {
+        pe1 += x0[i] * e1[i];
+        pe2 += x0[i] * e2[i];
+        pp += x0[i] * x0[i];
+    }
+
+    int k = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = i; j < n; ++j)
+            q[k++] += (i == j ? 1.0 : 0.0) - e1[i] * e1[j] - e2[i] * e2[j];
+        q[k++] += pe1 * e1[i] + pe2 * e2[i] - x0[i];
+    }
+    q[k] += pp - pe1 * pe1 - pe2 * pe2;
+}
+
+//-----------------------------------------------------------------------------
+
+// evaluate the sum of the quadrics `q0` and `q1` at x, in double
+static double evaluate_quadric(int n, const float* q0, const float* q1,
+                               const double* x)
+{
+    double error = 0.0;
+    int k = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        double r = (double(q0[k]) + q1[k]) * x[i];
+        ++k;
+        for (int j = i + 1; j < n; ++j, ++k)
+            r += 2.0 * (double(q0[k]) + q1[k]) * x[j];
+        r += 2.0 * (double(q0[k]) + q1[k]);
+        ++k;
+        error += r * x[i];
+    }
+    return error + (double(q0[k]) + q1[k]);
+}
+
+//=============================================================================
+
+void decimate_compact(SurfaceMesh& _mesh, unsigned int _target_complexity,
+                      bool _attributes)
+{
+    CompactDecimater deci(_mesh, _attributes);
+    deci.initialize();
+    deci.decimate(_target_complexity);
+
+    // remove the collapsed elements, like pmp::decimate()
+    _mesh.garbage_collection();
+}
+
+//=============================================================================
+
+CompactDecimater::CompactDecimater(SurfaceMesh& mesh, bool attributes)
+    : mesh_(mesh), dim_(3), scale_(1.0)
+{
+    points_ = mesh_.vertex_property<Point>("v:point");
+
+    // attributes that take part in the quadrics
+    if (attributes)
+    {
+        texcoords_ = mesh_.get_vertex_property<TexCoord>("v:tex");
+        colors_ = mesh_.get_vertex_property<Color>("v:color");
+    }
+    if (texcoords_)
+        dim_ += 2;
+    if (colors_)
+        dim_ += 3;
+    stride_ = (dim_ + 1) * (dim_ + 2) / 2;
+
+    priority_ = mesh_.add_vertex_property<float>("v:prio", FLT_MAX);
+    heap_pos_ = mesh_.add_vertex_property<int>("v:heap", -1);
+    target_ = mesh_.add_vertex_property<Halfedge>("v:target");
+}
+
+//-----------------------------------------------------------------------------
+
+CompactDecimater::~CompactDecimater()
+{
+    mesh_.remove_vertex_property(priority_);
+    mesh_.remove_vertex_property(heap_pos_);
+    mesh_.remove_vertex_property(target_);
+}
+
+//-----------------------------------------------------------------------------
+
+size_t CompactDecimater::memory_usage() const
+{
+    return quadrics_.capacity() * sizeof(float) +
+           mesh_.vertices_size() *
+               (sizeof(float) + sizeof(int) + sizeof(Halfedge));
+}
+
+//-----------------------------------------------------------------------------
+
+void CompactDecimater::coordinates(Vertex v, double* x) const
+{
+    int i = 0;
+    for (int j = 0; j < 3; ++j)
+        x[i++] = (double(points_[v][j]) - center_[j]) / scale_;
+    if (texcoords_)
+        for (int j = 0; j < 2; ++j)
+            x[i++] = texcoords_[v][j];
+    if (colors_)
+        for (int j = 0; j < 3; ++j)
+            x[i++] = colors_[v][j];
+}
+
+//-----------------------------------------------------------------------------
+
+void CompactDecimater::initialize()
+{
+    // center and scale the positions to the unit box, which keeps the float
+    // coefficients accurate and the attributes comparable to the geometry
+    BoundingBox bb;
+    for (auto v : mesh_.vertices())
+        bb += points_[v];
+    center_ = bb.center();
+    scale_ = std::max(double(bb.size()), DBL_MIN);
+
+    quadrics_.assign(mesh_.vertices_size() * stride_, 0.0f);
+
+    // each vertex sums the quadrics of its faces in double, and is rounded to
+    // float once
+    const int n_vertices = mesh_.vertices_size();
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_vertices; ++i)
+    {
+        Vertex v(i);
+        if (mesh_.is_deleted(v))
+            continue;
+
+        double q[max_stride] = {};
+        double x[3][max_dim];
+        for (auto f : mesh_.faces(v))
+        {
+            int j = 0;
+            for (auto vf : mesh_.vertices(f))
+            {
+                coordinates(vf, x[j]);
+                if (++j == 3)
+                    break;
+            }
+            add_face_quadric(dim_, x[0], x[1], x[2], q);
+        }
+
+        float* qv = quadric(v);
+        for (int k = 0; k < stride_; ++k)
+            qv[k] = float(q[k]);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+bool CompactDecimater::is_collapse_legal(Halfedge h) const
+{
+    Vertex v0 = mesh_.from_vertex(h);
+    Vertex v1 = mesh_.to_vertex(h);
+    Point p1 = points_[v1];
+
+    // topological test
+    if (!mesh_.is_collapse_ok(h))
+        return false;
+
+    // boundary test
+    if (mesh_.is_boundary(v0) && !mesh_.is_boundary(v1))
+        return false;
+
+    // test for normal flips on local copies of the corners, faces incident
+    // to v1 degenerate and are skipped
+    for (auto f : mesh_.faces(v0))
+    {
+        Point q[3], r[3];
+        int i = 0;
+        bool skip = false;
+        for (auto v : mesh_.vertices(f))
+        {
+            if (v == v1)
+            {
+                skip = true;
+                break;
+            }
+            if (i < 3)
+            {
+                q[i] = points_[v];
+                r[i] = (v == v0) ? p1 : q[i];
+                ++i;
+            }
+        }
+        if (skip)
+            continue;
+
+        auto n_prev = cross(q[1] - q[0], q[2] - q[0]);
+        auto n_post = cross(r[1] - r[0], r[2] - r[0]);
+        if (dot(n_prev, n_post) < 0.0)
+            return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+float CompactDecimater::collapse_priority(Halfedge h) const
+{
+    if (!is_collapse_legal(h))
+        return FLT_MAX;
+
+    Vertex v0 = mesh_.from_vertex(h);
+    Vertex v1 = mesh_.to_vertex(h);
+
+    double x[max_dim];
+    coordinates(v1, x);
+    return evaluate_quadric(dim_, quadric(v0), quadric(v1), x);
+}
+
+//-----------------------------------------------------------------------------
+
+void CompactDecimater::enqueue_vertex(PriorityQueue& queue, Vertex v)
+{
+    float prio = FLT_MAX;
+    Halfedge target;
+
+    for (auto h : mesh_.halfedges(v))
+    {
+        float p = collapse_priority(h);
+        if (p < prio)
+        {
+            prio = p;
+            target = h;
+        }
+    }
+
+    priority_[v] = prio;
+    target_[v] = target;
+
+    if (target.is_valid())
+    {
+        if (queue.is_stored(v))
+            queue.update(v);
+        else
+            queue.insert(v);
+    }
+    else if (queue.is_stored(v))
+    {
+        queue.remove(v);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void CompactDecimater::decimate(unsigned int _target_complexity)
+{
+    PriorityQueue queue(HeapInterface(priority_, heap_pos_));
+    queue.reserve(mesh_.n_vertices());
+    for (auto v : mesh_.vertices())
+    {
+        heap_pos_[v] = -1;
+        enqueue_vertex(queue, v);
+    }
+
+    while (mesh_.n_vertices() > _target_complexity && !queue.empty())
+    {
+        Vertex v = queue.front();
+        Halfedge h = target_[v];
+        queue.pop_front();
+
+        // the cheapest collapse might have become illegal since it was
+        // queued, it gets another chance once a neighbor collapses
+        if (!is_collapse_legal(h))
+            continue;
+
+        Vertex v0 = mesh_.from_vertex(h);
+        Vertex v1 = mesh_.to_vertex(h);
+
+        // merge the quadrics in double, store them as float
+        float* q0 = quadric(v0);
+        float* q1 = quadric(v1);
+        for (int k = 0; k < stride_; ++k)
+            q1[k] = float(double(q1[k]) + double(q0[k]));
+
+        mesh_.collapse(h);
+
+        enqueue_vertex(queue, v1);
+        for (auto vv : mesh_.vertices(v1))
+            enqueue_vertex(queue, vv);
+    }
+
+    optimize_vertices();
+}
+
+//-----------------------------------------------------------------------------
+
+void CompactDecimater::optimize_vertices()
+{
+    const int n = dim_;
+    Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, max_dim, max_dim>
+        A(n, n);
+    Eigen::Matrix<double, Eigen::Dynamic, 1, 0, max_dim, 1> b(n), x(n);
+
+    for (auto v : mesh_.vertices())
+    {
+        const float* q = quadric(v);
+        int k = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            for (int j = i; j < n; ++j, ++k)
+                A(i, j) = A(j, i) = q[k];
+            b(i) = -double(q[k++]);
+        }
+
+        // solve A x = -b, keep the vertex if A is (close to) singular
+        Eigen::LDLT<decltype(A)> ldlt(A);
+        const auto D = ldlt.vectorD();
+        if (ldlt.info() != Eigen::Success ||
+            !(D.minCoeff() > 1e-8 * D.maxCoeff()))
+            continue;
+        x = ldlt.solve(b);
+        if (!x.allFinite())
+            continue;
+
+        int i = 0;
+        for (int j = 0; j < 3; ++j)
+            points_[v][j] = x(i++) * scale_ + center_[j];
+        if (texcoords_)
+            for (int j = 0; j < 2; ++j)
+                texcoords_[v][j] = x(i++);
+        if (colors_)
+            for (int j = 0; j < 3; ++j)
+                colors_[v][j] = std::min(std::max(x(i++), 0.0), 1.0);
+    }
+}
+
+//=============================================================================
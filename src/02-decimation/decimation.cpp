@@ -11,15 +11,23 @@
 #include "Quadric.h"
 #include <pmp/algorithms/SurfaceNormals.h>
 #include <float.h>
+#include <algorithm>
 using namespace pmp;
 
 //=============================================================================
 
-void decimate(SurfaceMesh &_mesh, unsigned int _target_complexity)
+void decimate(SurfaceMesh &_mesh, unsigned int _target_complexity,
+              bool _parallel)
 {
     Decimater deci(_mesh);
     deci.initialize();
-    deci.decimate(_target_complexity);
+    if (_parallel)
+        deci.decimate_parallel(_target_complexity);
+    else
+        deci.decimate(_target_complexity);
+
+    // remove the collapsed elements, like pmp::decimate()
+    _mesh.garbage_collection();
 }
 
 //=============================================================================
@@ -30,9 +38,12 @@ Decimater::Decimater(SurfaceMesh &m)
     // get properties for vertex positions
     points = mesh.vertex_property<Point>("v:point");
 
-    // add properties for vertex quadric and halfedge priority
+    // add properties for vertex quadric, face normal, halfedge priority
+    // and heap position
     quadrics = mesh.add_vertex_property<Quadric>("v:quadric");
-    priority = mesh.add_halfedge_property<float>("h:prio");
+    normals = mesh.add_face_property<Normal>("f:deci_normal");
+    priority = mesh.add_halfedge_property<float>("h:prio", FLT_MAX);
+    heap_pos = mesh.add_halfedge_property<int>("h:heap", -1);
 }
 
 //-----------------------------------------------------------------------------
@@ -41,7 +52,9 @@ Decimater::~Decimater()
 {
     // clean-up properties we added in the constructor
     mesh.remove_vertex_property(quadrics);
+    mesh.remove_face_property(normals);
     mesh.remove_halfedge_property(priority);
+    mesh.remove_halfedge_property(heap_pos);
 }
 
 //-----------------------------------------------------------------------------
@@ -55,14 +68,37 @@ void Decimater::initialize()
         - SurfaceNormals::compute_face_normal(mesh, f) computes the normal for face f
     */
 
-    for (auto v : mesh.vertices())
+    // face normals, kept up to date during decimation
+    const int n_faces = mesh.faces_size();
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_faces; ++i)
+    {
+        Face f(i);
+        if (!mesh.is_deleted(f))
+            normals[f] = SurfaceNormals::compute_face_normal(mesh, f);
+    }
+
+    const int n_vertices = mesh.vertices_size();
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_vertices; ++i)
     {
+        Vertex v(i);
+        if (mesh.is_deleted(v))
+            continue;
         auto p = points[v];
+        quadrics[v] = Quadric();
         for (auto f : mesh.faces(v))
-        {
-            auto n = SurfaceNormals::compute_face_normal(mesh, f);
-            quadrics[v] += Quadric(n, p);
-        }
+            quadrics[v] += Quadric(normals[f], p);
+    }
+
+    // seed the collapse priorities, decimate() builds its queue from them
+    const int n_halfedges = mesh.halfedges_size();
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (int i = 0; i < n_halfedges; ++i)
+    {
+        Halfedge h(i);
+        if (!mesh.is_deleted(h))
+            priority[h] = collapse_priority(h);
     }
 }
 
@@ -73,7 +109,6 @@ bool Decimater::is_collapse_legal(Halfedge h)
     // collect two vertices and their positions
     Vertex v0 = mesh.from_vertex(h);
     Vertex v1 = mesh.to_vertex(h);
-    Point p0 = points[v0];
     Point p1 = points[v1];
 
     // topological test
@@ -91,21 +126,28 @@ bool Decimater::is_collapse_legal(Halfedge h)
 
     for (auto f : mesh.faces(v0))
     {
-        auto skip = false;
+        // corners of f after moving v0 to p1, as local copies such that the
+        // mesh is not touched and the test can run concurrently.
+        // faces incident to v1 degenerate and are skipped.
+        Point r[3];
+        int i = 0;
+        bool skip = false;
         for (auto v : mesh.vertices(f))
         {
             if (v == v1)
+            {
                 skip = true;
+                break;
+            }
+            if (i < 3)
+                r[i++] = (v == v0) ? p1 : points[v];
         }
         if (skip)
             continue;
 
-        auto n_prev = SurfaceNormals::compute_face_normal(mesh, f);
-        points[v0] = p1;
-        auto n_post = SurfaceNormals::compute_face_normal(mesh, f);
-        points[v0] = p0;
+        auto n_post = cross(r[1] - r[0], r[2] - r[0]);
 
-        if (dot(n_prev, n_post) < 0.0)
+        if (dot(normals[f], n_post) < 0.0)
             return false;
     }
 
@@ -137,6 +179,33 @@ float Decimater::collapse_priority(Halfedge h)
 
 //-----------------------------------------------------------------------------
 
+void Decimater::update_normals(Vertex v)
+{
+    for (auto f : mesh.faces(v))
+        normals[f] = SurfaceNormals::compute_face_normal(mesh, f);
+}
+
+//-----------------------------------------------------------------------------
+
+void Decimater::enqueue_halfedge(PriorityQueue& queue, Halfedge h)
+{
+    priority[h] = collapse_priority(h);
+
+    if (priority[h] < FLT_MAX)
+    {
+        if (queue.is_stored(h))
+            queue.update(h);
+        else
+            queue.insert(h);
+    }
+    else if (queue.is_stored(h))
+    {
+        queue.remove(h);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
 float Decimater::quadric_error() const
 {
     float error(0);
@@ -149,7 +218,7 @@ float Decimater::quadric_error() const
 
 //-----------------------------------------------------------------------------
 
-void Decimater::decimate(unsigned int _target_complexity)
+void Decimater::decimate(unsigned int _target_complexity, bool _optimize)
 {
     /** \todo Perform main decimation loop
         while not done
@@ -163,21 +232,25 @@ void Decimater::decimate(unsigned int _target_complexity)
         (note: inverting the quadric matrix might throw a numerical exception)
     */
 
-    while (mesh.n_vertices() > _target_complexity)
+    // queue of all legal collapses, ordered by priority
+    PriorityQueue queue(HeapInterface(priority, heap_pos));
+    queue.reserve(mesh.n_halfedges());
+    for (auto h : mesh.halfedges())
     {
-        auto pmin = FLT_MAX;
-        Halfedge hmin;
-        for (auto h : mesh.halfedges())
-        {
-            if (priority[h] < pmin)
-            {
-                hmin = h;
-                pmin = priority[h];
-            }
-        }
+        heap_pos[h] = -1;
+        if (priority[h] < FLT_MAX)
+            queue.insert(h);
+    }
 
-        if (pmin == FLT_MAX)
-            break;
+    while (mesh.n_vertices() > _target_complexity && !queue.empty())
+    {
+        Halfedge hmin = queue.front();
+        queue.pop_front();
+
+        // halfedges removed by earlier collapses stay in the queue and
+        // are dropped only here (lazy invalidation)
+        if (mesh.is_deleted(hmin))
+            continue;
 
         if (!mesh.is_collapse_ok(hmin))
         {
@@ -190,25 +263,121 @@ void Decimater::decimate(unsigned int _target_complexity)
         quadrics[v1] += quadrics[v0];
 
         mesh.collapse(hmin);
+        history.emplace_back(v0, v1);
+        update_normals(v1);
 
-        for(auto h1: mesh.halfedges(v1)) 
+        for (auto h1 : mesh.halfedges(v1))
         {
-            priority[h1] = collapse_priority(h1);
-            auto h2 = mesh.opposite_halfedge(h1);
-            priority[h2] = collapse_priority(h2);
+            enqueue_halfedge(queue, h1);
+            enqueue_halfedge(queue, mesh.opposite_halfedge(h1));
         }
     }
 
-    for (auto v : mesh.vertices()) {
-        try
+    if (_optimize)
+        optimize_positions();
+}
+
+//-----------------------------------------------------------------------------
+
+void Decimater::decimate_parallel(unsigned int _target_complexity)
+{
+    // vertices in the one-ring of a collapse of the current round
+    auto locked = mesh.add_vertex_property<bool>("v:locked", false);
+
+    std::vector<Halfedge> candidates, batch, changed;
+
+    while (mesh.n_vertices() > _target_complexity)
+    {
+        // legal collapses, their priorities are up to date
+        candidates.clear();
+        for (auto h : mesh.halfedges())
+            if (priority[h] < FLT_MAX)
+                candidates.push_back(h);
+        if (candidates.empty())
+            break;
+
+        // only consider the cheapest quarter per round, which keeps the
+        // order close to greedy
+        auto by_priority = [&](Halfedge a, Halfedge b) {
+            return priority[a] < priority[b];
+        };
+        size_t n_considered = std::max<size_t>(candidates.size() / 4, 1);
+        std::nth_element(candidates.begin(),
+                         candidates.begin() + (n_considered - 1),
+                         candidates.end(), by_priority);
+        std::sort(candidates.begin(), candidates.begin() + n_considered,
+                  by_priority);
+
+        // pick independent collapses: their endpoints must not lie in the
+        // one-ring of another collapse, then they share no face and do not
+        // change each other's priority
+        size_t n_needed = mesh.n_vertices() - _target_complexity;
+        batch.clear();
+        for (size_t i = 0; i < n_considered && batch.size() < n_needed; ++i)
         {
-            points[v] = quadrics[v].minimizer();
+            Halfedge h = candidates[i];
+            Vertex v0 = mesh.from_vertex(h);
+            Vertex v1 = mesh.to_vertex(h);
+            if (locked[v0] || locked[v1])
+                continue;
+
+            for (auto v : mesh.vertices(v0))
+                locked[v] = true;
+            for (auto v : mesh.vertices(v1))
+                locked[v] = true;
+            batch.push_back(h);
         }
-        catch(const std::exception& e)
+
+        // apply them; SurfaceMesh::collapse() updates global counters and
+        // therefore has to run serially
+        changed.clear();
+        for (auto h : batch)
         {
-            std::cerr << e.what() << '\n';
+            Vertex v0 = mesh.from_vertex(h);
+            Vertex v1 = mesh.to_vertex(h);
+
+            for (auto v : mesh.vertices(v0))
+                locked[v] = false;
+            for (auto v : mesh.vertices(v1))
+                locked[v] = false;
+
+            if (!mesh.is_collapse_ok(h))
+            {
+                priority[h] = FLT_MAX;
+                continue;
+            }
+
+            quadrics[v1] += quadrics[v0];
+            mesh.collapse(h);
+            history.emplace_back(v0, v1);
+            update_normals(v1);
+
+            for (auto h1 : mesh.halfedges(v1))
+            {
+                changed.push_back(h1);
+                changed.push_back(mesh.opposite_halfedge(h1));
+            }
         }
+
+        // re-evaluate the changed priorities, each halfedge occurs once
+        const int n_changed = changed.size();
+#pragma omp parallel for schedule(dynamic, 256)
+        for (int i = 0; i < n_changed; ++i)
+            priority[changed[i]] = collapse_priority(changed[i]);
     }
+
+    mesh.remove_vertex_property(locked);
+
+    optimize_positions();
+}
+
+//-----------------------------------------------------------------------------
+
+void Decimater::optimize_positions()
+{
+    // vertices with a singular quadric keep their position
+    for (auto v : mesh.vertices())
+        points[v] = quadrics[v].minimizer(points[v], points[v]);
 }
 
 //=============================================================================
@@ -10,14 +10,25 @@
 //=============================================================================
 
 #include <pmp/SurfaceMesh.h>
+#include <pmp/algorithms/Heap.h>
 #include "Quadric.h"
+#include <utility>
+#include <vector>
 using namespace pmp;
 
 //=============================================================================
 
 /// convenience function for mesh decimation
-/// simply constructs a Decimator object and calls initialize() and decimate().
-void decimate(SurfaceMesh& _mesh, unsigned int _target_complexity);
+/// simply constructs a Decimator object and calls initialize() and decimate(),
+/// or decimate_parallel() if `_parallel` is set.
+void decimate(SurfaceMesh& _mesh, unsigned int _target_complexity,
+              bool _parallel = false);
+
+/// convenience function for memory-lean decimation, see CompactDecimater.
+/// `_attributes` selects whether vertex texture coordinates and colors are
+/// preserved through attribute quadrics.
+void decimate_compact(SurfaceMesh& _mesh, unsigned int _target_complexity,
+                      bool _attributes = true);
 
 //=============================================================================
 
@@ -31,13 +42,60 @@ public:
     /// destructor
     ~Decimater();
 
-    /// initialize the per-vertex error quadrics
+    /// initialize the per-vertex error quadrics and the collapse priorities
     void initialize();
 
-    /// decimate down to `n_vertices`
-    void decimate(unsigned int n_vertices);
+    /// decimate down to `n_vertices`. Without `optimize`, the remaining
+    /// vertices keep their positions, e.g., if only collapses() is needed.
+    void decimate(unsigned int n_vertices, bool optimize = true);
+
+    /// decimate down to `n_vertices` in rounds of independent collapses.
+    /// Each round picks cheap collapses in priority order whose endpoints
+    /// do not touch the one-ring of another collapse of the round, applies
+    /// them, and re-evaluates the changed priorities in parallel. Close to,
+    /// but not exactly, the greedy order of decimate().
+    void decimate_parallel(unsigned int n_vertices);
+
+    /// the collapses performed so far, in order, as pairs of the removed
+    /// vertex and the vertex it was merged into
+    const std::vector<std::pair<Vertex, Vertex>>& collapses() const
+    {
+        return history;
+    }
 
 private:
+    /// heap interface: orders halfedges by their collapse priority and
+    /// stores their position in the heap in a halfedge property
+    class HeapInterface
+    {
+    public:
+        HeapInterface(HalfedgeProperty<float> prio, HalfedgeProperty<int> pos)
+            : prio_(prio), pos_(pos)
+        {
+        }
+
+        bool less(Halfedge h0, Halfedge h1) { return prio_[h0] < prio_[h1]; }
+        bool greater(Halfedge h0, Halfedge h1) { return prio_[h0] > prio_[h1]; }
+        int get_heap_position(Halfedge h) { return pos_[h]; }
+        void set_heap_position(Halfedge h, int pos) { pos_[h] = pos; }
+
+    private:
+        HalfedgeProperty<float> prio_;
+        HalfedgeProperty<int> pos_;
+    };
+
+    using PriorityQueue = Heap<Halfedge, HeapInterface>;
+
+    /// recompute the priority of `h` and update its entry in `queue`
+    void enqueue_halfedge(PriorityQueue& queue, Halfedge h);
+
+    /// recompute the cached normals of the faces incident to `v`,
+    /// after a collapse into `v` changed their corners
+    void update_normals(Vertex v);
+
+    /// move each vertex to the optimal position wrt its quadric
+    void optimize_positions();
+
     /// is collapsing the halfedge `h` allowed?
     bool is_collapse_legal(Halfedge h);
 
@@ -54,8 +112,105 @@ private:
 
     // custom properties we need
     VertexProperty<Point> points;
-    VertexProperty<Quadric> quadrics;
+    VertexProperty<Quadric> quadrics;  ///< double precision, see Quadric
+    FaceProperty<Normal> normals;
     HalfedgeProperty<float> priority;
+    HalfedgeProperty<int> heap_pos;
+
+    // collapse sequence, see collapses()
+    std::vector<std::pair<Vertex, Vertex>> history;
+};
+
+//=============================================================================
+
+/// Memory-lean variant of the Decimater for large meshes (implemented in
+/// decimation-compact.cpp). It keeps a single generalized error quadric per
+/// vertex in float, over the position and (optionally) the vertex texture
+/// coordinates "v:tex" and colors "v:color", such that these attributes are
+/// simplified along with the geometry. Quadric sums are formed and evaluated
+/// in double in a normalized, centered frame. Collapses are queued per vertex
+/// (its cheapest outgoing halfedge) and no face normals are cached, which
+/// saves the halfedge and face properties of the Decimater.
+class CompactDecimater
+{
+public:
+    /// give a mesh in the constructor, `attributes` enables attribute quadrics
+    CompactDecimater(SurfaceMesh& mesh, bool attributes = true);
+
+    /// destructor
+    ~CompactDecimater();
+
+    /// initialize the per-vertex quadrics
+    void initialize();
+
+    /// decimate down to `n_vertices`
+    void decimate(unsigned int n_vertices);
+
+    /// number of bytes used by the decimation data
+    size_t memory_usage() const;
+
+private:
+    /// heap interface: orders vertices by the priority of their cheapest
+    /// outgoing collapse
+    class HeapInterface
+    {
+    public:
+        HeapInterface(VertexProperty<float> prio, VertexProperty<int> pos)
+            : prio_(prio), pos_(pos)
+        {
+        }
+
+        bool less(Vertex v0, Vertex v1) { return prio_[v0] < prio_[v1]; }
+        bool greater(Vertex v0, Vertex v1) { return prio_[v0] > prio_[v1]; }
+        int get_heap_position(Vertex v) { return pos_[v]; }
+        void set_heap_position(Vertex v, int pos) { pos_[v] = pos; }
+
+    private:
+        VertexProperty<float> prio_;
+        VertexProperty<int> pos_;
+    };
+
+    using PriorityQueue = Heap<Vertex, HeapInterface>;
+
+    /// coordinates of `v` in quadric space: normalized position and attributes
+    void coordinates(Vertex v, double* x) const;
+
+    /// the quadric coefficients of `v`
+    float* quadric(Vertex v) { return &quadrics_[v.idx() * stride_]; }
+    const float* quadric(Vertex v) const { return &quadrics_[v.idx() * stride_]; }
+
+    /// is collapsing the halfedge `h` allowed?
+    bool is_collapse_legal(Halfedge h) const;
+
+    /// what is the priority of collapsing the halfedge `h`?
+    float collapse_priority(Halfedge h) const;
+
+    /// find the cheapest collapse of `v` and update its entry in `queue`
+    void enqueue_vertex(PriorityQueue& queue, Vertex v);
+
+    /// move each vertex and its attributes to the optimum of its quadric
+    void optimize_vertices();
+
+private:
+    SurfaceMesh& mesh_;
+
+    VertexProperty<Point> points_;
+    VertexProperty<TexCoord> texcoords_;
+    VertexProperty<Color> colors_;
+
+    VertexProperty<float> priority_;
+    VertexProperty<int> heap_pos_;
+    VertexProperty<Halfedge> target_;
+
+    /// dimension of quadric space and coefficients per quadric
+    int dim_, stride_;
+
+    /// upper triangles of the (dim+1)x(dim+1) quadric matrices, per vertex
+    std::vector<float> quadrics_;
+
+    /// positions are mapped to (p - center) / scale
+    Point center_;
+    double scale_;
 };
 
 //=============================================================================
@@ -16,6 +16,7 @@ void compute_mean_curvature(SurfaceMesh &mesh)
 {
     auto curvature = mesh.vertex_property<Scalar>("v:curv");
     auto points = mesh.get_vertex_property<Point>("v:point");
+    GeometryCache cache(mesh);
 
     for (auto v : mesh.vertices())
     {
@@ -33,9 +34,9 @@ void compute_mean_curvature(SurfaceMesh &mesh)
         Point sum(0,0,0);
         for (auto h : mesh.halfedges(v)) { 
             sum += (points[mesh.to_vertex(h)] - points[v])
-            * cotan(mesh, mesh.edge(h));   
+            * cache.cotan(mesh.edge(h));   
         }
-        curvature[v] = norm(sum / area(mesh, v)) / 2;
+        curvature[v] = norm(sum / cache.area(v)) / 2;
     }
 
     curvature_to_texture_coordinates(mesh);
@@ -47,6 +48,7 @@ void compute_gauss_curvature(SurfaceMesh &mesh)
 {
     auto curvature = mesh.vertex_property<Scalar>("v:curv");
     auto points = mesh.get_vertex_property<Point>("v:point");
+    GeometryCache cache(mesh);
 
     for (auto v : mesh.vertices())
     {
@@ -67,7 +69,7 @@ void compute_gauss_curvature(SurfaceMesh &mesh)
             auto b = points[mesh.from_vertex(h2)] - points[mesh.to_vertex(h2)];
             sum += acos(dot(a, b) / (norm(a) * norm(b)));
         }
-        curvature[v] = (2 * M_PI - sum) / area(mesh, v);
+        curvature[v] = (2 * M_PI - sum) / cache.area(v);
     }
 
     curvature_to_texture_coordinates(mesh);
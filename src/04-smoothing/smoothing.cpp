@@ -11,6 +11,7 @@
 #include <laplace.h>
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
+#include <iostream>
 
 #define SPARSE 1
 
@@ -35,17 +36,22 @@ void explicit_smoothing(SurfaceMesh& mesh,
      *   - experiment with different time-steps; when does it blow up?
      **/
 
+    GeometryCache cache(mesh);
     for(auto e : mesh.edges()) {
-        eweight[e] = use_uniform_laplace ? 1 : cotan(mesh, e);
+        eweight[e] = use_uniform_laplace ? 1 : cache.cotan(e);
     }
 
     for(unsigned int i = 0; i < N; i++) {
+        // weights stay fixed, areas follow the moving vertices
+        if (i > 0)
+            cache.update_areas();
+
         for (auto v : mesh.vertices()) {
             laplace[v] = Point(0,0,0);
             for (auto h : mesh.halfedges(v)) {
                     laplace[v] += eweight[mesh.edge(h)] * (points[mesh.to_vertex(h)] - points[v]);
             }
-            laplace[v] /= area(mesh, v);
+            laplace[v] /= cache.area(v);
         }
         
         for (auto v : mesh.vertices()) {
@@ -63,12 +69,66 @@ void explicit_smoothing(SurfaceMesh& mesh,
 
 //-----------------------------------------------------------------------------
 
+void SmoothingContext::reset()
+{
+    mesh_ = nullptr;
+    multigrid_.reset();
+    assembler_.reset();
+    cache_.reset();
+    A_ = SparseMatrix();
+}
+
+//-----------------------------------------------------------------------------
+
+const SparseMatrix& SmoothingContext::system(const SurfaceMesh& mesh,
+                                             double dt)
+{
+    // new pattern for another mesh or other element counts, otherwise only
+    // the geometry is updated and the values are refilled
+    if (mesh_ != &mesh || !cache_ || cache_->sizes_changed())
+    {
+        mesh_ = &mesh;
+        cache_ = std::make_unique<GeometryCache>(mesh);
+        assembler_ = std::make_unique<LaplaceAssembler>(mesh);
+        multigrid_.reset();
+        pattern_changed_ = true;
+    }
+    else
+    {
+        cache_->update();
+        pattern_changed_ = false;
+    }
+
+    assembler_->combination(*cache_, 1.0, -dt, A_);
+    return A_;
+}
+
+//-----------------------------------------------------------------------------
+
+LaplaceMultigrid& SmoothingContext::multigrid()
+{
+    assert(mesh_);
+    if (!multigrid_)
+        multigrid_ = std::make_unique<LaplaceMultigrid>(*mesh_);
+    return *multigrid_;
+}
+
+//-----------------------------------------------------------------------------
+
 void implicit_smoothing(SurfaceMesh& mesh,
-                        Scalar dt)
+                        Scalar dt,
+                        SmoothingContext* context)
 {
     if (!mesh.n_vertices())
         return;
 
+    // the matrices are indexed by the element indices, so deleted elements
+    // (e.g., left by Decimater::decimate()) have to be removed first
+    if (mesh.n_vertices() != mesh.vertices_size() ||
+        mesh.n_edges() != mesh.edges_size() ||
+        mesh.n_faces() != mesh.faces_size())
+        mesh.garbage_collection();
+
     auto points = mesh.get_vertex_property<Point>("v:point");
     const unsigned int n = mesh.n_vertices();
 
@@ -81,6 +141,56 @@ void implicit_smoothing(SurfaceMesh& mesh,
      *   - This should work for all time-steps dt!
      *   - Let's use the cotan weights for this task only
      **/
+
+    // without a context from the caller, a local one builds everything
+    SmoothingContext local_context;
+    if (!context)
+        context = &local_context;
+
+    // A = M - dt * S, B = M * P
+    const SparseMatrix& A = context->system(mesh, dt);
+    const GeometryCache& cache = context->cache();
+
+    DenseMatrix B(n, 3);
+    for (auto v : mesh.vertices())
+    {
+        const double a = cache.area(v);
+        for (int k = 0; k < 3; ++k)
+            B(v.idx(), k) = a * points[v][k];
+    }
+
+    DenseMatrix X;
+    if (context->solver_type() == SmoothingContext::Multigrid)
+    {
+        // iterate from the current positions, which are close for small dt
+        X.resize(n, 3);
+        for (auto v : mesh.vertices())
+            for (int k = 0; k < 3; ++k)
+                X(v.idx(), k) = points[v][k];
+
+        LaplaceMultigrid& multigrid = context->multigrid();
+        if (!multigrid.compute(A) || !multigrid.solve(B, X))
+        {
+            std::cerr << "implicit_smoothing: multigrid did not converge\n";
+            return;
+        }
+    }
+    else
+    {
+        // the symbolic analysis only depends on the connectivity
+        LaplaceSolver& solver = context->solver();
+        if (context->pattern_changed())
+            solver.analyze(A);
+
+        if (!solver.factorize(A) || !solver.solve(B, X))
+        {
+            std::cerr << "implicit_smoothing: factorization failed\n";
+            return;
+        }
+    }
+
+    for (auto v : mesh.vertices())
+        points[v] = Point(X(v.idx(), 0), X(v.idx(), 1), X(v.idx(), 2));
 }
 
 //=============================================================================
@@ -10,10 +10,78 @@
 //=============================================================================
 
 #include <pmp/SurfaceMesh.h>
+#include <laplace.h>
+#include <multigrid.h>
+#include <memory>
 using namespace pmp;
 
 //=============================================================================
 
+/// State of implicit smoothing kept across steps on the same mesh: the
+/// geometry cache, the Laplace assembler with its sparsity pattern, the
+/// system matrix and the solver. Repeated steps only recompute the cotan
+/// weights and areas, refill the values of the matrix and refactorize
+/// numerically. Everything is rebuilt for another mesh or when the element
+/// counts change. Changes of the connectivity that keep all counts (edge
+/// flips, another mesh of the same size loaded into the same object) are
+/// not detected: call reset() after them.
+///
+/// The system is solved by a sparse Cholesky factorization or, for large
+/// meshes, by LaplaceMultigrid, whose hierarchy is built once per
+/// connectivity and whose cost grows about linearly with the mesh size.
+class SmoothingContext
+{
+public:
+    /// linear solver used by implicit_smoothing()
+    enum Solver
+    {
+        Cholesky,  ///< sparse LDL^T, see LaplaceSolver
+        Multigrid  ///< multigrid-preconditioned CG, see LaplaceMultigrid
+    };
+
+    explicit SmoothingContext(Solver solver = Cholesky)
+        : mesh_(nullptr), pattern_changed_(false), solver_type_(solver)
+    {
+    }
+
+    /// forget the mesh, the next step rebuilds everything
+    void reset();
+
+    /// select the linear solver for the next steps
+    void set_solver(Solver solver) { solver_type_ = solver; }
+
+    /// the selected linear solver
+    Solver solver_type() const { return solver_type_; }
+
+    /// assemble A = M - dt * S of `mesh`, see LaplaceAssembler::combination()
+    const SparseMatrix& system(const SurfaceMesh& mesh, double dt);
+
+    /// did the last system() build a new pattern?
+    bool pattern_changed() const { return pattern_changed_; }
+
+    /// cotan weights and areas of the last system()
+    const GeometryCache& cache() const { return *cache_; }
+
+    /// Cholesky solver for the system, keeps its symbolic analysis
+    LaplaceSolver& solver() { return solver_; }
+
+    /// multigrid solver for the mesh of the last system(), its hierarchy is
+    /// built on first use after a new pattern
+    LaplaceMultigrid& multigrid();
+
+private:
+    const SurfaceMesh* mesh_;
+    std::unique_ptr<GeometryCache> cache_;
+    std::unique_ptr<LaplaceAssembler> assembler_;
+    SparseMatrix A_;
+    bool pattern_changed_;
+    Solver solver_type_;
+    LaplaceSolver solver_;
+    std::unique_ptr<LaplaceMultigrid> multigrid_;
+};
+
+//=============================================================================
+
 /// @brief perform Laplacian smoothing (explicit integration)
 /// @param mesh The mesh to be smoothed
 /// @param iters Number of iterations
@@ -25,7 +93,11 @@ void explicit_smoothing(SurfaceMesh& mesh,
 /// @brief perform Laplacian smoothing (implicit integration)
 /// @param mesh The mesh to be smoothed
 /// @param timestep The time step
+/// @param context Optional context kept by the caller, such that repeated
+///                steps on the same connectivity reuse the matrix pattern
+///                and the symbolic analysis of the solver
 void implicit_smoothing(SurfaceMesh& mesh,
-                        Scalar timestep = 0.001);
+                        Scalar timestep = 0.001,
+                        SmoothingContext* context = nullptr);
 
 //=============================================================================
@@ -24,8 +24,9 @@ bool parameterize_boundary(SurfaceMesh &mesh)
         tex[v] = TexCoord(0, 0);
 
     // pre-compute cotan weight per edge
+    GeometryCache cache(mesh);
     for (auto e : mesh.edges())
-        eweight[e] = cotan(mesh, e);
+        eweight[e] = cache.cotan(e);
 
         /** \todo Map boundary loop to unit circle in texture domain
          *  - walk around boundary and collect boundary vertices
@@ -92,9 +92,10 @@ bool Viewer::load_data(const char *_filename)
 
     bool ok;
     mesh_.clear();
+    smoothing_context_.reset();
 
     // load as pointset
-    ok = pointset_.read_data(_filename);
+    ok = pointset_.read_data(_filename, downsampling_);
     if (!ok)
     {
         std::cerr << "cannot read file " << _filename << std::endl;
@@ -345,17 +346,25 @@ void Viewer::process_imgui()
             // Hoppe parameters
             static int hoppe_resolution = 50;
             static int hoppe_nneighbors = 1;
+            static bool hoppe_narrow_band = false;
             ImGui::PushItemWidth(100);
             ImGui::Text("Grid resolution");
-            ImGui::SliderInt("##MC Resolution", &hoppe_resolution, 10, 200);
+            ImGui::SliderInt("##MC Resolution", &hoppe_resolution, 10,
+                             hoppe_narrow_band ? 1000 : 200);
+            ImGui::Text("Neighbors");
+            ImGui::SliderInt("##Hoppe Neighbors", &hoppe_nneighbors, 1, 16);
             ImGui::PopItemWidth();
+            if (ImGui::Checkbox("Narrow band", &hoppe_narrow_band) && !hoppe_narrow_band)
+                hoppe_resolution = std::min(hoppe_resolution, 200);
 
             if (ImGui::Button("Hoppe reconstruction"))
             {
                 Timer timer; 
                 timer.start();
 
-                reconstruct_hoppe(pointset_, mesh_, hoppe_resolution, hoppe_nneighbors);
+                reconstruct_hoppe(pointset_, mesh_, hoppe_resolution, hoppe_nneighbors,
+                                  ExecutionPolicy::Parallel, hoppe_narrow_band ? 2 : 0);
+                smoothing_context_.reset();
                 update_mesh();
                 draw_pointset_ = false;
 
@@ -369,19 +378,34 @@ void Viewer::process_imgui()
 
             // Poisson parameters
             static int octree_depth = 7;
+            static int memory_budget = 0;
             ImGui::PushItemWidth(100);
             ImGui::Text("Octree depth");
-            ImGui::SliderInt("##Poisson OD", &octree_depth, 5, 10);
+            ImGui::SliderInt("##Poisson OD", &octree_depth, 5, 12);
+            ImGui::Text("Memory budget (MB, 0 = none)");
+            ImGui::SliderInt("##Poisson MB", &memory_budget, 0, 16384);
             ImGui::PopItemWidth();
 
+            if (ImGui::Button("Estimate memory"))
+            {
+                PoissonEstimate estimate = estimate_poisson(pointset_.points_, octree_depth);
+                std::cout << "Poisson depth " << octree_depth << ": "
+                          << estimate.nodes << " nodes, "
+                          << estimate.memory / (1024 * 1024) << " MB" << std::endl;
+            }
+
             if (ImGui::Button("Poisson reconstruction"))
             {
                 Timer timer; 
                 timer.start();
 
-                reconstruct_poisson(pointset_, mesh_, octree_depth, 8, 2.0);
-                update_mesh();
-                draw_pointset_ = false;
+                if (reconstruct_poisson(pointset_, mesh_, octree_depth, 8, 2.0, 0,
+                                        size_t(memory_budget) * 1024 * 1024))
+                {
+                    smoothing_context_.reset();
+                    update_mesh();
+                    draw_pointset_ = false;
+                }
 
                 timer.stop();
                 std::cout << "Reconstruction took " << timer << std::endl;
@@ -401,11 +425,15 @@ void Viewer::process_imgui()
         if (mesh_.n_vertices() > 0)
         {
             static int target_percentage = 10;
+            static int mode = 0;
 
             ImGui::PushItemWidth(100);
             ImGui::Text("Vertices to remain");
             ImGui::SliderInt("##Percentage", &target_percentage, 1, 99, "%d%%");
             ImGui::PopItemWidth();
+            ImGui::RadioButton("Greedy", &mode, 0);
+            ImGui::RadioButton("Independent-set rounds", &mode, 1);
+            ImGui::RadioButton("Compact, with attributes", &mode, 2);
 
             ImGui::Spacing();
 
@@ -413,7 +441,11 @@ void Viewer::process_imgui()
             {
                 Timer timer; 
                 timer.start();
-                ::decimate(mesh_, mesh_.n_vertices() * 0.01 * target_percentage);
+                unsigned int n = mesh_.n_vertices() * 0.01 * target_percentage;
+                if (mode == 2)
+                    decimate_compact(mesh_, n);
+                else
+                    ::decimate(mesh_, n, mode == 1);
                 update_mesh();
                 timer.stop();
                 std::cout << "Decimation took " << timer << std::endl;
@@ -502,12 +534,18 @@ void Viewer::process_imgui()
             ImGui::PopItemWidth();
             ImGui::Spacing();
 
+            static bool multigrid = false;
+            if (ImGui::Checkbox("Multigrid solver", &multigrid))
+                smoothing_context_.set_solver(multigrid
+                                                  ? SmoothingContext::Multigrid
+                                                  : SmoothingContext::Cholesky);
+
             if (ImGui::Button("Implicit smoothing (cotan)"))
             {
                 Timer timer; 
                 timer.start();
                 Scalar dt = timestep * radius_ * radius_;
-                implicit_smoothing(mesh_, dt);
+                implicit_smoothing(mesh_, dt, &smoothing_context_);
                 update_mesh();
                 timer.stop();
                 std::cout << "Implicit smoothing took " << timer << std::endl;
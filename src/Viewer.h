@@ -11,6 +11,7 @@
 
 #include <pmp/visualization/MeshViewer.h>
 #include <01-reconstruction/PointSet.h>
+#include <04-smoothing/smoothing.h>
 
 using namespace pmp;
 
@@ -27,6 +28,9 @@ public:
     /// load points or mesh from file \p filename
     bool load_data(const char* _filename);
 
+    /// reduce point sets by voxel-grid downsampling while loading them
+    void set_downsampling(const VoxelDownsampling& _ds) { downsampling_ = _ds; }
+
 protected:
     /// draw the scene in different draw modes
     virtual void draw(const std::string& draw_mode) override;
@@ -45,6 +49,9 @@ private:
     /// input point set for surface reconstruction
     PointSet pointset_;
 
+    /// downsampling applied when loading point sets
+    VoxelDownsampling downsampling_;
+
     /// draw the pointset?
     bool draw_pointset_;
 
@@ -57,6 +64,10 @@ private:
     bool run_parameterization_;
     /// whether to use cotan weights or uniform weights
     bool parameterization_uniform_;
+
+    /// keeps matrix pattern and symbolic factorization between implicit
+    /// smoothing steps
+    SmoothingContext smoothing_context_;
 };
 
 //=============================================================================
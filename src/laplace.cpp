@@ -8,6 +8,8 @@
 //=============================================================================
 
 #include "laplace.h"
+#include <algorithm>
+#include <float.h>
 
 //=============================================================================
 
@@ -35,7 +37,6 @@ Scalar area(const SurfaceMesh &mesh, Vertex v)
 Scalar cotan(const SurfaceMesh &mesh, Edge e)
 {
     Scalar weight(0);
-    auto points = mesh.get_vertex_property<Point>("v:point");
 
     /**  \todo Compute the cotangent weight for the edge e,
      *   defined by the two angles opposite to edge e.
@@ -49,14 +50,14 @@ Scalar cotan(const SurfaceMesh &mesh, Edge e)
 
     auto v_A = mesh.to_vertex(h0);
     auto v_B = mesh.to_vertex(h1);
-    auto p_A = points[v_A];
-    auto p_B = points[v_B];
+    auto p_A = mesh.position(v_A);
+    auto p_B = mesh.position(v_B);
 
     auto cot_alpha = 0.0;
     if (!mesh.is_boundary(h0))
     {
         auto v_alpha = mesh.to_vertex(mesh.next_halfedge(h0));
-        auto p_alpha = points[v_alpha];
+        auto p_alpha = mesh.position(v_alpha);
         auto x_alpha = p_A - p_alpha;
         auto y_alpha = p_B - p_alpha;
         cot_alpha = dot(x_alpha, y_alpha) / norm(cross(x_alpha, y_alpha));
@@ -66,7 +67,7 @@ Scalar cotan(const SurfaceMesh &mesh, Edge e)
     if (!mesh.is_boundary(h1))
     {
         auto v_beta = mesh.to_vertex(mesh.next_halfedge(h1));
-        auto p_beta = points[v_beta];
+        auto p_beta = mesh.position(v_beta);
         auto x_beta = p_A - p_beta;
         auto y_beta = p_B - p_beta;
         cot_beta = dot(x_beta, y_beta) / norm(cross(x_beta, y_beta));
@@ -81,46 +82,332 @@ Scalar cotan(const SurfaceMesh &mesh, Edge e)
     return weight;
 }
 
+//=============================================================================
+
+// cotangent of the angle at p opposite to the edge (a, b), zero for
+// degenerate triangles, where it would be NaN or inf
+static Scalar corner_cotan(const Point &a, const Point &b, const Point &p)
+{
+    const Point x = a - p, y = b - p;
+    const Scalar s = norm(cross(x, y));
+    return s > FLT_MIN ? dot(x, y) / s : 0;
+}
+
+//=============================================================================
+
+GeometryCache::GeometryCache(const SurfaceMesh &mesh)
+    : mesh_(mesh), sizes_(0)
+{
+    update();
+}
+
 //-----------------------------------------------------------------------------
 
-void setup_mass_matrix(const SurfaceMesh &mesh, SparseMatrix &M)
+void GeometryCache::update()
 {
-    const unsigned int n = mesh.n_vertices();
-    std::vector<Eigen::Triplet<double>> triplets;
-    triplets.reserve(n);
+    const int n_edges = mesh_.edges_size();
+    cotan_.assign(n_edges, 0);
 
-    for (auto vi : mesh.vertices())
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_edges; ++i)
     {
-        triplets.emplace_back(vi.idx(), vi.idx(), area(mesh, vi));
+        Edge e(i);
+        if (mesh_.is_deleted(e))
+            continue;
+
+        // as cotan(), but degenerate triangles do not poison the tables
+        Scalar w = 0;
+        for (int j = 0; j < 2; ++j)
+        {
+            Halfedge h = mesh_.halfedge(e, j);
+            if (!mesh_.is_boundary(h))
+                w += corner_cotan(mesh_.position(mesh_.from_vertex(h)),
+                                  mesh_.position(mesh_.to_vertex(h)),
+                                  mesh_.position(mesh_.to_vertex(
+                                      mesh_.next_halfedge(h))));
+        }
+        cotan_[i] = w / 2;
     }
 
-    M.resize(n, n);
-    M.setFromTriplets(triplets.begin(), triplets.end());
+    update_areas();
+    sizes_ = size_stamp(mesh_);
 }
 
 //-----------------------------------------------------------------------------
 
-void setup_stiffness_matrix(const SurfaceMesh &mesh, SparseMatrix &S)
+void GeometryCache::update_areas()
+{
+    const int n_faces = mesh_.faces_size();
+    const int n_vertices = mesh_.vertices_size();
+    face_area_.assign(n_faces, 0);
+    vertex_area_.assign(n_vertices, 0);
+
+#pragma omp parallel
+    {
+#pragma omp for schedule(static)
+        for (int i = 0; i < n_faces; ++i)
+        {
+            Face f(i);
+            if (!mesh_.is_deleted(f))
+                face_area_[i] = ::area(mesh_, f);
+        }
+
+        // gather (instead of scatter) face areas, no two threads write the
+        // same vertex
+#pragma omp for schedule(static)
+        for (int i = 0; i < n_vertices; ++i)
+        {
+            Vertex v(i);
+            if (mesh_.is_deleted(v))
+                continue;
+            Scalar a = 0;
+            for (auto f : mesh_.faces(v))
+                a += face_area_[f.idx()];
+            vertex_area_[i] = a / 3.0;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+uint64_t GeometryCache::size_stamp(const SurfaceMesh &mesh)
+{
+    // mix element counts and array sizes (splitmix64)
+    auto mix = [](uint64_t x) {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    };
+
+    uint64_t h = mix(mesh.n_vertices());
+    h = mix(h ^ mesh.n_edges());
+    h = mix(h ^ mesh.n_faces());
+    h = mix(h ^ mesh.vertices_size());
+    h = mix(h ^ mesh.edges_size());
+    return mix(h ^ mesh.faces_size());
+}
+
+//=============================================================================
+
+LaplaceAssembler::LaplaceAssembler(const SurfaceMesh &mesh)
+    : mesh_(mesh)
+{
+    rebuild();
+}
+
+//-----------------------------------------------------------------------------
+
+void LaplaceAssembler::rebuild()
+{
+    assert(mesh_.n_vertices() == mesh_.vertices_size());
+    const int n = mesh_.n_vertices();
+
+    // column sizes from the valences, then their prefix sums
+    offsets_.assign(n + 1, 0);
+#pragma omp parallel for schedule(static)
+    for (int j = 0; j < n; ++j)
+        offsets_[j + 1] = mesh_.valence(Vertex(j)) + 1;
+    for (int j = 0; j < n; ++j)
+        offsets_[j + 1] += offsets_[j];
+
+    rows_.resize(offsets_[n]);
+    edges_.resize(offsets_[n]);
+
+    // each column gets its one-ring and the diagonal, sorted by row
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (int j = 0; j < n; ++j)
+    {
+        Vertex vj(j);
+        int k = offsets_[j];
+        rows_[k] = j;
+        edges_[k] = -1;
+        ++k;
+        for (auto h : mesh_.halfedges(vj))
+        {
+            rows_[k] = mesh_.to_vertex(h).idx();
+            edges_[k] = mesh_.edge(h).idx();
+            ++k;
+        }
+
+        // insertion sort, columns are short
+        for (int a = offsets_[j] + 1; a < k; ++a)
+        {
+            const int r = rows_[a], e = edges_[a];
+            int b = a;
+            for (; b > offsets_[j] && rows_[b - 1] > r; --b)
+            {
+                rows_[b] = rows_[b - 1];
+                edges_[b] = edges_[b - 1];
+            }
+            rows_[b] = r;
+            edges_[b] = e;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void LaplaceAssembler::setup_pattern(SparseMatrix &A) const
+{
+    const int n = offsets_.size() - 1;
+    const size_t nnz = rows_.size();
+
+    if (A.rows() == n && A.cols() == n && A.isCompressed() &&
+        size_t(A.nonZeros()) == nnz &&
+        std::equal(offsets_.begin(), offsets_.end(), A.outerIndexPtr()) &&
+        std::equal(rows_.begin(), rows_.end(), A.innerIndexPtr()))
+        return;
+
+    A.resize(n, n);
+    A.resizeNonZeros(nnz);
+    std::copy(offsets_.begin(), offsets_.end(), A.outerIndexPtr());
+    std::copy(rows_.begin(), rows_.end(), A.innerIndexPtr());
+}
+
+//-----------------------------------------------------------------------------
+
+void LaplaceAssembler::stiffness(const GeometryCache &cache,
+                                 SparseMatrix &S) const
+{
+    combination(cache, 0.0, 1.0, S);
+}
+
+//-----------------------------------------------------------------------------
+
+void LaplaceAssembler::combination(const GeometryCache &cache, double alpha,
+                                   double beta, SparseMatrix &A) const
 {
-    const unsigned int n = mesh.n_vertices();
-    std::vector<Eigen::Triplet<double>> triplets;
-    triplets.reserve(7 * n);
+    setup_pattern(A);
 
-    for (auto vi : mesh.vertices())
+    const int n = offsets_.size() - 1;
+    double *values = A.valuePtr();
+
+#pragma omp parallel for schedule(static)
+    for (int j = 0; j < n; ++j)
     {
-        Scalar sum_weights = 0.0;
-        for (auto h : mesh.halfedges(vi))
+        double sum_weights = 0.0;
+        int diagonal = -1;
+        for (int k = offsets_[j]; k < offsets_[j + 1]; ++k)
         {
-            Vertex vj = mesh.to_vertex(h);
-            Scalar w = cotan(mesh, mesh.edge(h));
+            if (edges_[k] < 0)
+            {
+                diagonal = k;
+                continue;
+            }
+            const double w = cache.cotan(Edge(edges_[k]));
             sum_weights += w;
-            triplets.emplace_back(vi.idx(), vj.idx(), w);
+            values[k] = beta * w;
         }
-        triplets.emplace_back(vi.idx(), vi.idx(), -sum_weights);
+        values[diagonal] =
+            alpha * cache.area(Vertex(j)) - beta * sum_weights;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void LaplaceAssembler::mass(const GeometryCache &cache, SparseMatrix &M) const
+{
+    const int n = offsets_.size() - 1;
+
+    if (!(M.rows() == n && M.cols() == n && M.isCompressed() &&
+          M.nonZeros() == n))
+    {
+        M.resize(n, n);
+        M.resizeNonZeros(n);
+        for (int j = 0; j <= n; ++j)
+            M.outerIndexPtr()[j] = j;
+        for (int j = 0; j < n; ++j)
+            M.innerIndexPtr()[j] = j;
     }
 
-    S.resize(n, n);
-    S.setFromTriplets(triplets.begin(), triplets.end());
+#pragma omp parallel for schedule(static)
+    for (int j = 0; j < n; ++j)
+        M.valuePtr()[j] = cache.area(Vertex(j));
+}
+
+//=============================================================================
+
+Eigen::VectorXd LaplaceOperator::diagonal() const
+{
+    const SurfaceMesh &mesh = cache_.mesh();
+    const int n = rows();
+    Eigen::VectorXd d(n);
+
+#pragma omp parallel for schedule(static)
+    for (int j = 0; j < n; ++j)
+    {
+        Vertex v(j);
+        double sum_weights = 0.0;
+        for (auto h : mesh.halfedges(v))
+            sum_weights += cache_.cotan(mesh.edge(h));
+        d(j) = alpha_ * cache_.area(v) - beta_ * sum_weights;
+    }
+
+    return d;
+}
+
+//=============================================================================
+
+void LaplaceSolver::analyze(const SparseMatrix &A)
+{
+    ldlt_.analyzePattern(A);
+    rows_ = A.rows();
+    nonzeros_ = A.nonZeros();
+    ++n_analyses_;
+}
+
+//-----------------------------------------------------------------------------
+
+bool LaplaceSolver::factorize(const SparseMatrix &A)
+{
+    // the caller tells when the pattern changes, only catch the obvious
+    if (n_analyses_ == 0 || A.rows() != rows_ || A.nonZeros() != nonzeros_)
+        analyze(A);
+
+    ldlt_.factorize(A);
+    ++n_factorizations_;
+
+    return ldlt_.info() == Eigen::Success;
+}
+
+//-----------------------------------------------------------------------------
+
+bool LaplaceSolver::solve(const DenseMatrix &B, DenseMatrix &X) const
+{
+    if (ldlt_.info() != Eigen::Success)
+        return false;
+
+    X = ldlt_.solve(B);
+    return ldlt_.info() == Eigen::Success;
+}
+
+//=============================================================================
+
+void setup_mass_matrix(const SurfaceMesh &mesh, SparseMatrix &M)
+{
+    setup_mass_matrix(GeometryCache(mesh), M);
+}
+
+//-----------------------------------------------------------------------------
+
+void setup_mass_matrix(const GeometryCache &cache, SparseMatrix &M)
+{
+    LaplaceAssembler(cache.mesh()).mass(cache, M);
+}
+
+//-----------------------------------------------------------------------------
+
+void setup_stiffness_matrix(const SurfaceMesh &mesh, SparseMatrix &S)
+{
+    setup_stiffness_matrix(GeometryCache(mesh), S);
+}
+
+//-----------------------------------------------------------------------------
+
+void setup_stiffness_matrix(const GeometryCache &cache, SparseMatrix &S)
+{
+    LaplaceAssembler(cache.mesh()).stiffness(cache, S);
 }
 
 //-----------------------------------------------------------------------------
@@ -11,6 +11,10 @@
 
 #include <pmp/SurfaceMesh.h>
 #include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <Eigen/IterativeLinearSolvers>
+#include <cstdint>
+#include <vector>
 
 using namespace pmp;
 
@@ -30,12 +34,296 @@ Scalar area(const SurfaceMesh& mesh, Vertex v);
 /// compute cotangent weight of edge e
 Scalar cotan(const SurfaceMesh& mesh, Edge e);
 
+//=============================================================================
+
+/// Cotangent weights per edge, triangle areas per face and (barycentric)
+/// Voronoi areas per vertex, computed once (in parallel) into flat arrays
+/// indexed by the element index. The cache does not watch the vertex
+/// positions (that would cost a pass over the mesh): whoever moves vertices
+/// calls update(), or update_areas() to keep the cotan weights of the last
+/// update(). sizes_changed() cheaply detects a change of the element counts,
+/// but not of the connectivity itself (e.g., edge flips).
+class GeometryCache
+{
+public:
+    /// compute all tables for `mesh`
+    explicit GeometryCache(const SurfaceMesh& mesh);
+
+    /// recompute all tables
+    void update();
+
+    /// recompute only face and vertex areas, e.g., when vertices moved but
+    /// the cotan weights are meant to stay fixed. The cotan weights still
+    /// belong to the geometry of the last update().
+    void update_areas();
+
+    /// have the element counts or array sizes changed since the last
+    /// update()? Only compares counts: edits that keep them (edge flips,
+    /// collapses and splits followed by garbage collection) go unnoticed.
+    bool sizes_changed() const { return sizes_ != size_stamp(mesh_); }
+
+    /// cotangent weight of edge e, see cotan(); corners of degenerate
+    /// triangles contribute zero
+    Scalar cotan(Edge e) const { return cotan_[e.idx()]; }
+
+    /// area of triangle f
+    Scalar area(Face f) const { return face_area_[f.idx()]; }
+
+    /// (barycentric) Voronoi area of vertex v
+    Scalar area(Vertex v) const { return vertex_area_[v.idx()]; }
+
+    /// the mesh the cache belongs to
+    const SurfaceMesh& mesh() const { return mesh_; }
+
+    /// stamp of the mesh's element counts and array sizes. It is not a
+    /// connectivity check: it stays the same when vertices move or when the
+    /// connectivity changes without changing any count.
+    static uint64_t size_stamp(const SurfaceMesh& mesh);
+
+private:
+    const SurfaceMesh& mesh_;
+    std::vector<Scalar> cotan_;
+    std::vector<Scalar> face_area_;
+    std::vector<Scalar> vertex_area_;
+    uint64_t sizes_;
+};
+
+//=============================================================================
+
+/// Assembles cotan Laplace matrices directly in compressed storage, without
+/// triplets. Column j holds the one-ring of vertex j plus the diagonal; the
+/// column offsets follow from the vertex valences and all columns are filled
+/// in one parallel pass. As the pattern only depends on the connectivity,
+/// assembling again into the same matrix only rewrites its values, e.g.,
+/// after vertices moved. Call rebuild() when the connectivity changed.
+class LaplaceAssembler
+{
+public:
+    /// build the sparsity pattern of `mesh`, which must not have deleted vertices
+    explicit LaplaceAssembler(const SurfaceMesh& mesh);
+
+    /// rebuild the pattern from the current connectivity
+    void rebuild();
+
+    /// fill `S` with the cotan stiffness matrix
+    void stiffness(const GeometryCache& cache, SparseMatrix& S) const;
+
+    /// fill `M` with the (diagonal) mass matrix
+    void mass(const GeometryCache& cache, SparseMatrix& M) const;
+
+    /// fill `A` with alpha * M + beta * S, which has the pattern of S,
+    /// e.g., M - dt * S for implicit smoothing
+    void combination(const GeometryCache& cache, double alpha, double beta,
+                     SparseMatrix& A) const;
+
+    /// number of non-zeros of S
+    size_t n_nonzeros() const { return rows_.size(); }
+
+private:
+    /// give `A` the pattern of S, unless it already has it
+    void setup_pattern(SparseMatrix& A) const;
+
+    const SurfaceMesh& mesh_;
+    std::vector<int> offsets_;  ///< start of each column, n+1 entries
+    std::vector<int> rows_;     ///< row of each non-zero
+    std::vector<int> edges_;    ///< edge of each non-zero, -1 on the diagonal
+};
+
+//=============================================================================
+
+class LaplaceOperator;
+
+namespace Eigen {
+namespace internal {
+// LaplaceOperator looks like a sparse matrix to Eigen's iterative solvers
+template <>
+struct traits<LaplaceOperator> : public traits<::SparseMatrix>
+{
+};
+} // namespace internal
+} // namespace Eigen
+
+/// Matrix-free version of the matrix alpha * M + beta * S that
+/// LaplaceAssembler::combination() would assemble: products are evaluated
+/// over the halfedge one-rings with the weights and areas of a
+/// GeometryCache, so no SparseMatrix is stored. It plugs into Eigen's
+/// iterative solvers as a matrix, e.g.,
+///
+///     LaplaceOperator A(cache, 1.0, -dt);   // M - dt * S, s.p.d.
+///     Eigen::ConjugateGradient<LaplaceOperator, Eigen::Lower | Eigen::Upper,
+///                              LaplaceJacobiPreconditioner> cg(A);
+///     X = cg.solve(B);
+///
+/// Walking the one-rings makes each product about 5x slower than with the
+/// assembled matrix (bunny.off: 740 vs. 145 ms for CG at the same number
+/// of iterations), so this is only meant for meshes whose matrix does not
+/// fit into memory; otherwise use LaplaceAssembler.
+class LaplaceOperator : public Eigen::EigenBase<LaplaceOperator>
+{
+public:
+    typedef double Scalar;
+    typedef double RealScalar;
+    typedef int StorageIndex;
+    enum
+    {
+        ColsAtCompileTime = Eigen::Dynamic,
+        MaxColsAtCompileTime = Eigen::Dynamic,
+        IsRowMajor = false
+    };
+
+    /// the operator alpha * M + beta * S of the mesh of `cache`
+    LaplaceOperator(const GeometryCache& cache, double alpha = 0.0,
+                    double beta = 1.0)
+        : cache_(cache), alpha_(alpha), beta_(beta)
+    {
+    }
+
+    Eigen::Index rows() const { return cache_.mesh().n_vertices(); }
+    Eigen::Index cols() const { return cache_.mesh().n_vertices(); }
+
+    /// lazy product with a dense vector, evaluated by apply()
+    template <typename Rhs>
+    Eigen::Product<LaplaceOperator, Rhs, Eigen::AliasFreeProduct> operator*(
+        const Eigen::MatrixBase<Rhs>& x) const
+    {
+        return Eigen::Product<LaplaceOperator, Rhs, Eigen::AliasFreeProduct>(
+            *this, x.derived());
+    }
+
+    /// y += scale * A * x for the vectors x and y
+    template <typename Rhs, typename Dest>
+    void apply(const Rhs& x, Dest& y, double scale) const
+    {
+        const SurfaceMesh& mesh = cache_.mesh();
+        const int n = rows();
+
+#pragma omp parallel for schedule(static)
+        for (int j = 0; j < n; ++j)
+        {
+            Vertex v(j);
+            const double xj = x.coeff(j);
+            double sum = 0.0;
+            for (auto h : mesh.halfedges(v))
+                sum += cache_.cotan(mesh.edge(h)) *
+                       (x.coeff(mesh.to_vertex(h).idx()) - xj);
+            y.coeffRef(j) += scale * (alpha_ * cache_.area(v) * xj + beta_ * sum);
+        }
+    }
+
+    /// the diagonal of the operator, e.g., for Jacobi preconditioning
+    Eigen::VectorXd diagonal() const;
+
+private:
+    const GeometryCache& cache_;
+    double alpha_, beta_;
+};
+
+namespace Eigen {
+namespace internal {
+// evaluate LaplaceOperator * vector through LaplaceOperator::apply()
+template <typename Rhs>
+struct generic_product_impl<LaplaceOperator, Rhs, SparseShape, DenseShape,
+                            GemvProduct>
+    : generic_product_impl_base<LaplaceOperator, Rhs,
+                                generic_product_impl<LaplaceOperator, Rhs>>
+{
+    typedef typename Product<LaplaceOperator, Rhs>::Scalar Scalar;
+
+    template <typename Dest>
+    static void scaleAndAddTo(Dest& dst, const LaplaceOperator& lhs,
+                              const Rhs& rhs, const Scalar& alpha)
+    {
+        lhs.apply(rhs, dst, alpha);
+    }
+};
+} // namespace internal
+} // namespace Eigen
+
+/// Jacobi preconditioner for LaplaceOperator in Eigen's iterative solvers.
+/// Eigen's DiagonalPreconditioner needs an assembled matrix to find the
+/// diagonal, this one asks the operator.
+class LaplaceJacobiPreconditioner : public Eigen::DiagonalPreconditioner<double>
+{
+public:
+    LaplaceJacobiPreconditioner() {}
+
+    explicit LaplaceJacobiPreconditioner(const LaplaceOperator& A)
+    {
+        compute(A);
+    }
+
+    LaplaceJacobiPreconditioner& analyzePattern(const LaplaceOperator&)
+    {
+        return *this;
+    }
+
+    LaplaceJacobiPreconditioner& factorize(const LaplaceOperator& A)
+    {
+        m_invdiag = A.diagonal();
+        for (Eigen::Index i = 0; i < m_invdiag.size(); ++i)
+            m_invdiag(i) = m_invdiag(i) != 0.0 ? 1.0 / m_invdiag(i) : 1.0;
+        m_isInitialized = true;
+        return *this;
+    }
+
+    LaplaceJacobiPreconditioner& compute(const LaplaceOperator& A)
+    {
+        return factorize(A);
+    }
+};
+
+//=============================================================================
+
+/// Solver for symmetric positive definite systems with a fixed sparsity
+/// pattern, e.g., (M - dt*S) X = M P of implicit smoothing. The symbolic
+/// analysis (fill-reducing ordering, elimination tree) of the sparse LDL^T
+/// factorization is kept across calls, factorize() is numeric only. The
+/// pattern is not compared on every call: whoever changes it calls
+/// analyze(), only a change in size or number of non-zeros is detected.
+class LaplaceSolver
+{
+public:
+    LaplaceSolver()
+        : rows_(0), nonzeros_(0), n_analyses_(0), n_factorizations_(0)
+    {
+    }
+
+    /// symbolic analysis of the pattern of `A`
+    void analyze(const SparseMatrix& A);
+
+    /// numeric factorization of `A`, which has the pattern of the last
+    /// analyze(). Returns false if the factorization fails.
+    bool factorize(const SparseMatrix& A);
+
+    /// solve A X = B for all columns of `B` at once
+    bool solve(const DenseMatrix& B, DenseMatrix& X) const;
+
+    /// number of symbolic analyses done so far
+    unsigned int n_analyses() const { return n_analyses_; }
+
+    /// number of numeric factorizations done so far
+    unsigned int n_factorizations() const { return n_factorizations_; }
+
+private:
+    Eigen::SimplicialLDLT<SparseMatrix> ldlt_;
+    Eigen::Index rows_, nonzeros_;  ///< size of the analyzed matrix
+    unsigned int n_analyses_, n_factorizations_;
+};
+
+//=============================================================================
+
 /// compute cotan mass matrix
 void setup_mass_matrix(const SurfaceMesh& mesh, SparseMatrix& M);
 
+/// compute cotan mass matrix from cached areas
+void setup_mass_matrix(const GeometryCache& cache, SparseMatrix& M);
+
 /// compute cotan stiffness matrix
 void setup_stiffness_matrix(const SurfaceMesh& mesh, SparseMatrix& S);
 
+/// compute cotan stiffness matrix from cached weights
+void setup_stiffness_matrix(const GeometryCache& cache, SparseMatrix& S);
+
 /// compute two selector matrices that do / don't satisfy boolean criterion
 void setup_selector_matrices(const SurfaceMesh &mesh, 
                              VertexProperty<bool> is_selected, 
@@ -8,13 +8,102 @@
 //=============================================================================
 
 #include "Viewer.h"
+#include <01-reconstruction/PointCloudFile.h>
+#include <01-reconstruction/reconstruction.h>
+#include <pmp/Timer.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//=============================================================================
+
+// time Poisson reconstruction of a point set for 1, 2, 4, ... threads up to
+// the number of available threads (best of three runs each)
+static int benchmark_poisson(const char* _filename, int _depth)
+{
+    PointCloudData data;
+    if (!read_point_cloud(_filename, data))
+    {
+        std::cerr << "Cannot read " << _filename << std::endl;
+        return 1;
+    }
+
+#ifdef _OPENMP
+    const int max_threads = omp_get_max_threads();
+#else
+    const int max_threads = 1;
+    std::cout << "Built without OpenMP, Poisson runs single-threaded\n";
+#endif
+
+    std::cout << _filename << ": " << data.points.size()
+              << " points, octree depth " << _depth << std::endl;
+
+    double t1 = 0.0;
+    for (int threads=1; ; threads=std::min(2*threads, max_threads))
+    {
+        pmp::SurfaceMesh mesh;
+        double best = 0.0;
+        for (int run=0; run<3; ++run)
+        {
+            pmp::Timer timer;
+            timer.start();
+            reconstruct_poisson(data.points, data.normals, mesh, _depth, 8, 2.0,
+                                threads);
+            timer.stop();
+            best = run ? std::min(best, timer.elapsed()) : timer.elapsed();
+        }
+        if (threads == 1) t1 = best;
+
+        printf("%3d threads: %9.1f ms, speedup %5.2f  (%zu vertices, %zu faces)\n",
+               threads, best, t1/best, mesh.n_vertices(), mesh.n_faces());
+
+        if (threads == max_threads) break;
+    }
+
+    return 0;
+}
+
+//=============================================================================
 
 int main(int argc, char **argv)
 {
+    // convert a point set to the binary .bpc format, no window needed
+    if (argc == 4 && strcmp(argv[1], "--convert") == 0)
+        return convert_point_cloud(argv[2], argv[3]) ? 0 : 1;
+
+    // scaling of Poisson reconstruction with the number of threads:
+    // --benchmark-poisson [<point set> [<octree depth>]]
+    if (argc >= 2 && strcmp(argv[1], "--benchmark-poisson") == 0)
+    {
+        const char* filename = argc > 2 ? argv[2] : POINTSET_DIRECTORY "bunny.pts";
+        const int   depth    = argc > 3 ? atoi(argv[3]) : 8;
+        return benchmark_poisson(filename, depth);
+    }
+
+    // optional voxel-grid downsampling of point sets:
+    // --voxel <size> [--budget <MB>]
+    VoxelDownsampling downsampling;
+    const char* filename = nullptr;
+    for (int i=1; i<argc; ++i)
+    {
+        if (strcmp(argv[i], "--voxel") == 0 && i+1 < argc)
+            downsampling.voxel_size = atof(argv[++i]);
+        else if (strcmp(argv[i], "--budget") == 0 && i+1 < argc)
+            downsampling.memory_budget = (size_t)(atof(argv[++i]) * 1024 * 1024);
+        else
+            filename = argv[i];
+    }
+
     Viewer window("Geometric Modeling", 1280, 960);
+    window.set_downsampling(downsampling);
 
-    if (argc == 2)
-        window.load_data(argv[1]);
+    if (filename)
+        window.load_data(filename);
 
     return window.run();
 }
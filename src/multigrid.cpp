@@ -0,0 +1,266 @@
+//=============================================================================
+//
+//   Exercise code for the lecture "Geometric Modeling"
+//   by Prof. Dr. Mario Botsch, TU Dortmund
+//
+//   Copyright (C) 2023 Computer Graphics Group, TU Dortmund.
+//
+//=============================================================================
+
+#include "multigrid.h"
+#include <02-decimation/decimation.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+//=============================================================================
+
+// largest eigenvalue of D^-1 A, by power iteration
+static double spectral_radius(const SparseMatrix &A,
+                              const Eigen::VectorXd &inv_diagonal)
+{
+    const int n = A.rows();
+    Eigen::VectorXd x(n);
+    for (int i = 0; i < n; ++i)
+        x(i) = std::cos(0.7 * i);
+    x.normalize();
+
+    double rho = 1.0;
+    for (int i = 0; i < 15; ++i)
+    {
+        Eigen::VectorXd y = inv_diagonal.cwiseProduct(A * x);
+        rho = y.norm();
+        if (rho == 0.0)
+            break;
+        x = y / rho;
+    }
+    return rho;
+}
+
+//=============================================================================
+
+LaplaceMultigrid::LaplaceMultigrid(const SurfaceMesh &mesh, double ratio,
+                                   unsigned int n_coarsest)
+    : iterations_(0), error_(0.0)
+{
+    assert(mesh.n_vertices() == mesh.vertices_size());
+    const int n = mesh.n_vertices();
+    sizes_.push_back(n);
+
+    // decimate a copy down to the coarsest level and record the collapses,
+    // the positions of the copy are not needed
+    SurfaceMesh copy = mesh;
+    Decimater decimater(copy);
+    decimater.initialize();
+    decimater.decimate(n_coarsest, false);
+    const auto &collapses = decimater.collapses();
+
+    // the vertex each removed vertex was merged into
+    std::vector<int> parent(n, -1);
+
+    // vertices of the current level, and their index on that level
+    std::vector<int> alive(n), index(n, -1);
+    std::iota(alive.begin(), alive.end(), 0);
+
+    size_t c = 0;
+    while (c < collapses.size())
+    {
+        const int n_fine = alive.size();
+        const int n_target =
+            std::max(int(n_coarsest), int(std::ceil(ratio * n_fine)));
+        const size_t c_end =
+            std::min(collapses.size(), c + size_t(std::max(n_fine - n_target, 1)));
+
+        for (; c < c_end; ++c)
+            parent[collapses[c].first.idx()] = collapses[c].second.idx();
+
+        for (int i = 0; i < n_fine; ++i)
+            index[alive[i]] = i;
+
+        // the remaining vertices form the coarse level
+        std::vector<int> coarse;
+        coarse.reserve(n_target);
+        std::vector<int> coarse_index(n_fine);
+        for (int i = 0; i < n_fine; ++i)
+        {
+            if (parent[alive[i]] < 0)
+            {
+                coarse_index[i] = coarse.size();
+                coarse.push_back(alive[i]);
+            }
+        }
+
+        // each vertex is aggregated to the vertex it was (eventually) merged
+        // into; collapses only merge vertices alive at that time, so the
+        // chain stays on this level
+        std::vector<Triplet> triplets;
+        triplets.reserve(n_fine);
+        for (int i = 0; i < n_fine; ++i)
+        {
+            int r = alive[i];
+            while (parent[r] >= 0)
+                r = parent[r];
+            triplets.emplace_back(i, coarse_index[index[r]], 1.0);
+        }
+
+        SparseMatrix P(n_fine, coarse.size());
+        P.setFromTriplets(triplets.begin(), triplets.end());
+        aggregations_.push_back(P);
+
+        alive.swap(coarse);
+        sizes_.push_back(alive.size());
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+bool LaplaceMultigrid::compute(const SparseMatrix &A)
+{
+    assert(A.rows() == sizes_[0] && A.cols() == sizes_[0]);
+
+    const int n_levels = this->n_levels();
+    operators_.resize(n_levels);
+    prolongations_.resize(n_levels - 1);
+    inv_diagonals_.resize(n_levels);
+
+    operators_[0] = A;
+    for (int k = 0; k < n_levels; ++k)
+    {
+        const SparseMatrix &Ak = operators_[k];
+
+        Eigen::VectorXd &inv_diagonal = inv_diagonals_[k];
+        inv_diagonal = Ak.diagonal();
+        for (int i = 0; i < inv_diagonal.size(); ++i)
+            inv_diagonal(i) = inv_diagonal(i) != 0.0 ? 1.0 / inv_diagonal(i) : 0.0;
+
+        if (k == n_levels - 1)
+            break;
+
+        // smooth the aggregation by one damped Jacobi step,
+        // P = (I - omega D^-1 A) P0 with omega = 4 / (3 rho(D^-1 A))
+        const SparseMatrix &P0 = aggregations_[k];
+        const double omega = 4.0 / (3.0 * spectral_radius(Ak, inv_diagonal));
+        SparseMatrix DAP0 = inv_diagonal.asDiagonal() * (Ak * P0);
+        prolongations_[k] = P0 - omega * DAP0;
+        prolongations_[k].prune(0.0);
+
+        // Galerkin coarse operator
+        const SparseMatrix &P = prolongations_[k];
+        SparseMatrix AP = Ak * P;
+        operators_[k + 1] = SparseMatrix(P.transpose()) * AP;
+    }
+
+    coarse_solver_.compute(operators_.back());
+    return coarse_solver_.info() == Eigen::Success;
+}
+
+//-----------------------------------------------------------------------------
+
+void LaplaceMultigrid::gauss_seidel(int level, const Eigen::VectorXd &b,
+                                    Eigen::VectorXd &x, bool forward) const
+{
+    // A is symmetric and stored completely, so column i is also row i
+    const SparseMatrix &A = operators_[level];
+    const Eigen::VectorXd &inv_diagonal = inv_diagonals_[level];
+    const int n = A.outerSize();
+
+    for (int s = 0; s < n; ++s)
+    {
+        const int i = forward ? s : n - 1 - s;
+        double sum = b(i);
+        for (SparseMatrix::InnerIterator it(A, i); it; ++it)
+            if (it.row() != i)
+                sum -= it.value() * x(it.row());
+        x(i) = sum * inv_diagonal(i);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void LaplaceMultigrid::vcycle(int level, const Eigen::VectorXd &b,
+                              Eigen::VectorXd &x) const
+{
+    if (level == n_levels() - 1)
+    {
+        x = coarse_solver_.solve(b);
+        return;
+    }
+
+    const SparseMatrix &A = operators_[level];
+    const SparseMatrix &P = prolongations_[level];
+
+    // pre-smoothing, coarse grid correction, post-smoothing
+    x.setZero(b.size());
+    gauss_seidel(level, b, x, true);
+
+    Eigen::VectorXd r = b - A * x;
+    Eigen::VectorXd bc = P.transpose() * r;
+    Eigen::VectorXd xc;
+    vcycle(level + 1, bc, xc);
+    x += P * xc;
+
+    gauss_seidel(level, b, x, false);
+}
+
+//-----------------------------------------------------------------------------
+
+bool LaplaceMultigrid::solve(const DenseMatrix &B, DenseMatrix &X,
+                             double tolerance, int max_iterations)
+{
+    const SparseMatrix &A = operators_[0];
+    const int n = A.rows();
+
+    if (X.rows() != n || X.cols() != B.cols())
+        X.setZero(n, B.cols());
+    iterations_ = 0;
+    error_ = 0.0;
+    bool converged = true;
+
+    for (int col = 0; col < B.cols(); ++col)
+    {
+        const Eigen::VectorXd b = B.col(col);
+        const double b_norm = b.norm();
+        if (b_norm == 0.0)
+        {
+            X.col(col).setZero();
+            continue;
+        }
+
+        // conjugate gradients, preconditioned by one V-cycle
+        Eigen::VectorXd x = X.col(col);
+        Eigen::VectorXd r = b - A * x, z, p, Ap;
+        vcycle(0, r, z);
+        p = z;
+        double rz = r.dot(z);
+
+        double residual = r.norm() / b_norm;
+        int it = 0;
+        while (it < max_iterations && !(residual < tolerance))
+        {
+            Ap = A * p;
+            const double alpha = rz / p.dot(Ap);
+            x += alpha * p;
+            r -= alpha * Ap;
+            ++it;
+
+            residual = r.norm() / b_norm;
+            if (residual < tolerance)
+                break;
+
+            vcycle(0, r, z);
+            const double rz_new = r.dot(z);
+            p = z + (rz_new / rz) * p;
+            rz = rz_new;
+        }
+
+        X.col(col) = x;
+        iterations_ = std::max(iterations_, it);
+        error_ = std::max(error_, residual);
+        if (!(residual < tolerance))
+            converged = false;
+    }
+
+    return converged;
+}
+
+//=============================================================================
@@ -0,0 +1,83 @@
+//=============================================================================
+//
+//   Exercise code for the lecture "Geometric Modeling"
+//   by Prof. Dr. Mario Botsch, TU Dortmund
+//
+//   Copyright (C) 2023 Computer Graphics Group, TU Dortmund.
+//
+//=============================================================================
+#pragma once
+//=============================================================================
+
+#include <laplace.h>
+#include <vector>
+
+//=============================================================================
+
+/// Geometric multigrid for symmetric positive definite Laplace systems
+/// A X = B on a triangle mesh, e.g., (M - dt*S) X = M P of implicit
+/// smoothing. Vertices fixed by Dirichlet constraints can be handled by
+/// giving them identity rows and columns in A (and moving their values to
+/// the right-hand side), such that A keeps the vertex ordering of the mesh.
+///
+/// The hierarchy comes from decimating a copy of the mesh with the
+/// Decimater: each level merges the vertices collapsed into each other
+/// between two vertex counts, the collapse records give the aggregates.
+/// The prolongation operators are these aggregations, smoothed by one
+/// damped Jacobi step (smoothed aggregation), coarse operators are the
+/// Galerkin products P^T A P, and the coarsest level is factorized
+/// directly. Systems are solved by conjugate gradients preconditioned with
+/// a symmetric V-cycle (Gauss-Seidel forward before, backward after the
+/// coarse correction).
+class LaplaceMultigrid
+{
+public:
+    /// build the hierarchy of `mesh`, each level has about `ratio` times
+    /// the vertices of the finer one, down to at most `n_coarsest` vertices
+    explicit LaplaceMultigrid(const SurfaceMesh& mesh, double ratio = 0.25,
+                              unsigned int n_coarsest = 1000);
+
+    /// set up all levels for the fine matrix `A`, whose rows and columns are
+    /// ordered like the vertices of the mesh. Returns false if the coarsest
+    /// level cannot be factorized.
+    bool compute(const SparseMatrix& A);
+
+    /// solve A X = B column by column up to the relative residual
+    /// `tolerance`, starting from `X` if it has the size of the solution
+    /// (e.g., the current positions), from zero otherwise. Returns false if
+    /// a column did not converge.
+    bool solve(const DenseMatrix& B, DenseMatrix& X, double tolerance = 1e-8,
+               int max_iterations = 200);
+
+    /// number of levels, including the finest one
+    int n_levels() const { return aggregations_.size() + 1; }
+
+    /// number of unknowns on `level`
+    int n_unknowns(int level) const { return sizes_[level]; }
+
+    /// maximum number of CG iterations of the last solve()
+    int iterations() const { return iterations_; }
+
+    /// largest relative residual of the last solve()
+    double error() const { return error_; }
+
+private:
+    /// x = V-cycle applied to the residual b on `level`
+    void vcycle(int level, const Eigen::VectorXd& b, Eigen::VectorXd& x) const;
+
+    /// Gauss-Seidel sweep on `level`, forward or backward
+    void gauss_seidel(int level, const Eigen::VectorXd& b, Eigen::VectorXd& x,
+                      bool forward) const;
+
+    std::vector<int> sizes_;                   ///< unknowns per level
+    std::vector<SparseMatrix> aggregations_;   ///< level k+1 -> level k
+    std::vector<SparseMatrix> prolongations_;  ///< smoothed aggregations
+    std::vector<SparseMatrix> operators_;      ///< A on each level
+    std::vector<Eigen::VectorXd> inv_diagonals_;
+    Eigen::SimplicialLDLT<SparseMatrix> coarse_solver_;
+
+    int iterations_;
+    double error_;
+};
+
+//=============================================================================